@@ -1,10 +1,28 @@
+/* directory.c: Directories.
+ *
+ * A directory is a file of fixed-size entries.  The first lookup in
+ * a directory reads all of its entries into the dentry cache, a hash
+ * table of (directory, name) pairs shared by every directory, and
+ * records the directory's free slots.  From then on lookups, adds
+ * and removes find their entry or slot without reading the
+ * directory, and a name missing from the cache is known to be
+ * missing from the disk too.  The cache is kept up to date by the
+ * functions below, which are the only writers of directories.
+ *
+ * If memory runs out, a directory's index is dropped and its
+ * operations scan the directory as before, until it is indexed
+ * again. */
+
 #include "filesys/directory.h"
+#include <hash.h>
 #include <stdio.h>
 #include <string.h>
 #include <list.h>
+#include "filesys/fat.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* A directory. */
 struct dir {
@@ -19,10 +37,69 @@ struct dir_entry {
 	bool in_use;                        /* In use or free? */
 };
 
+/* An entry of an indexed directory, in the dentry cache. */
+struct dentry {
+	struct hash_elem hash_elem;         /* Element in DENTRIES. */
+	struct list_elem list_elem;         /* Element in the index's list. */
+	disk_sector_t dir_sector;           /* Directory's inode sector. */
+	disk_sector_t inode_sector;         /* Sector number of header. */
+	off_t ofs;                          /* Offset of the entry. */
+	char name[NAME_MAX + 1];            /* Null terminated file name. */
+};
+
+/* The index of a directory whose entries are all in DENTRIES. */
+struct dir_index {
+	struct hash_elem elem;              /* Element in DIR_INDEXES. */
+	disk_sector_t sector;               /* Directory's inode sector. */
+	struct list dentries;               /* Its entries in DENTRIES. */
+	off_t end;                          /* Offset past the last slot. */
+	off_t *free_slots;                  /* Offsets of free slots. */
+	size_t free_cnt, free_cap;
+};
+
+static struct hash dentries;            /* Entries of indexed dirs. */
+static struct hash dir_indexes;         /* Indexed directories. */
+static struct lock dcache_lock;         /* Protects the above, and
+                                         * each lookup with the update
+                                         * that follows it. */
+
+/* Statistics. */
+static long long index_build_cnt;
+static long long index_hit_cnt;
+static long long index_miss_cnt;
+
+static uint64_t dentry_hash (const struct hash_elem *e, void *aux);
+static bool dentry_less (const struct hash_elem *a,
+		const struct hash_elem *b, void *aux);
+static uint64_t dir_index_hash (const struct hash_elem *e, void *aux);
+static bool dir_index_less (const struct hash_elem *a,
+		const struct hash_elem *b, void *aux);
+static void dir_index_drop (disk_sector_t sector);
+
+/* Sets up the dentry cache. */
+void
+dir_init (void) {
+	hash_init (&dentries, dentry_hash, dentry_less, NULL);
+	hash_init (&dir_indexes, dir_index_hash, dir_index_less, NULL);
+	lock_init (&dcache_lock);
+}
+
+/* Prints dentry cache statistics. */
+void
+dir_print_stats (void) {
+	printf ("Dentry cache: %lld directories indexed, %lld hits, "
+			"%lld negative hits\n",
+			index_build_cnt, index_hit_cnt, index_miss_cnt);
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
  * given SECTOR.  Returns true if successful, false on failure. */
 bool
 dir_create (disk_sector_t sector, size_t entry_cnt) {
+	/* An index left from a directory once in SECTOR is stale. */
+	lock_acquire (&dcache_lock);
+	dir_index_drop (sector);
+	lock_release (&dcache_lock);
 	return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
 }
 
@@ -46,7 +123,11 @@ dir_open (struct inode *inode) {
  * Return true if successful, false on failure. */
 struct dir *
 dir_open_root (void) {
+#ifdef EFILESYS
+	return dir_open (inode_open (cluster_to_sector (ROOT_DIR_CLUSTER)));
+#else
 	return dir_open (inode_open (ROOT_DIR_SECTOR));
+#endif
 }
 
 /* Opens and returns a new directory for the same inode as DIR.
@@ -71,20 +152,194 @@ dir_get_inode (struct dir *dir) {
 	return dir->inode;
 }
 
+static uint64_t
+dentry_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct dentry *d = hash_entry (e, struct dentry, hash_elem);
+	return hash_string (d->name) ^ hash_int (d->dir_sector);
+}
+
+static bool
+dentry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct dentry *a = hash_entry (a_, struct dentry, hash_elem);
+	const struct dentry *b = hash_entry (b_, struct dentry, hash_elem);
+	if (a->dir_sector != b->dir_sector)
+		return a->dir_sector < b->dir_sector;
+	return strcmp (a->name, b->name) < 0;
+}
+
+static uint64_t
+dir_index_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_int (hash_entry (e, struct dir_index, elem)->sector);
+}
+
+static bool
+dir_index_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct dir_index, elem)->sector
+		< hash_entry (b, struct dir_index, elem)->sector;
+}
+
+/* Returns the index of the directory whose inode is in SECTOR, or
+ * NULL if it is not indexed.  DCACHE_LOCK must be held. */
+static struct dir_index *
+dir_index_find (disk_sector_t sector) {
+	struct dir_index key;
+	struct hash_elem *e;
+
+	key.sector = sector;
+	e = hash_find (&dir_indexes, &key.elem);
+	return e != NULL ? hash_entry (e, struct dir_index, elem) : NULL;
+}
+
+/* Enters the entry for NAME at OFS in INDEX's directory into the
+ * dentry cache.  Returns false if out of memory.  DCACHE_LOCK must
+ * be held. */
+static bool
+dentry_add (struct dir_index *index, const char *name,
+		disk_sector_t inode_sector, off_t ofs) {
+	struct dentry *d = malloc (sizeof *d);
+
+	if (d == NULL)
+		return false;
+	d->dir_sector = index->sector;
+	d->inode_sector = inode_sector;
+	d->ofs = ofs;
+	strlcpy (d->name, name, sizeof d->name);
+	hash_insert (&dentries, &d->hash_elem);
+	list_push_back (&index->dentries, &d->list_elem);
+	return true;
+}
+
+/* Returns the cached entry for NAME in INDEX's directory, or NULL
+ * if the directory has no such entry.  DCACHE_LOCK must be held. */
+static struct dentry *
+dentry_find (struct dir_index *index, const char *name) {
+	struct dentry key;
+	struct hash_elem *e;
+
+	/* Too long to be in the directory, and to fit in KEY. */
+	if (strlen (name) > NAME_MAX)
+		return NULL;
+	key.dir_sector = index->sector;
+	strlcpy (key.name, name, sizeof key.name);
+	e = hash_find (&dentries, &key.hash_elem);
+	return e != NULL ? hash_entry (e, struct dentry, hash_elem) : NULL;
+}
+
+/* Records that the slot at OFS in INDEX's directory is free.
+ * Returns false if out of memory.  DCACHE_LOCK must be held. */
+static bool
+free_slot_push (struct dir_index *index, off_t ofs) {
+	if (index->free_cnt == index->free_cap) {
+		size_t cap = index->free_cap ? index->free_cap * 2 : 8;
+		off_t *slots = realloc (index->free_slots, cap * sizeof *slots);
+		if (slots == NULL)
+			return false;
+		index->free_slots = slots;
+		index->free_cap = cap;
+	}
+	index->free_slots[index->free_cnt++] = ofs;
+	return true;
+}
+
+/* Frees the index of the directory whose inode is in SECTOR and
+ * its entries in the dentry cache, if it is indexed.  DCACHE_LOCK
+ * must be held. */
+static void
+dir_index_drop (disk_sector_t sector) {
+	struct dir_index *index = dir_index_find (sector);
+
+	if (index == NULL)
+		return;
+	while (!list_empty (&index->dentries)) {
+		struct dentry *d = list_entry (list_pop_front (&index->dentries),
+				struct dentry, list_elem);
+		hash_delete (&dentries, &d->hash_elem);
+		free (d);
+	}
+	hash_delete (&dir_indexes, &index->elem);
+	free (index->free_slots);
+	free (index);
+}
+
+/* Returns the index of DIR, reading every entry of DIR into the
+ * dentry cache first if it is not indexed yet.  Returns NULL if out
+ * of memory.  DCACHE_LOCK must be held. */
+static struct dir_index *
+dir_index_get (const struct dir *dir) {
+	disk_sector_t sector = inode_get_inumber (dir->inode);
+	struct dir_index *index = dir_index_find (sector);
+	struct dir_entry e;
+	off_t ofs;
+	size_t i;
+
+	if (index != NULL)
+		return index;
+	index = malloc (sizeof *index);
+	if (index == NULL)
+		return NULL;
+	index->sector = sector;
+	list_init (&index->dentries);
+	index->free_slots = NULL;
+	index->free_cnt = index->free_cap = 0;
+	hash_insert (&dir_indexes, &index->elem);
+
+	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+			ofs += sizeof e)
+		if (e.in_use ? !dentry_add (index, e.name, e.inode_sector, ofs)
+				: !free_slot_push (index, ofs)) {
+			dir_index_drop (sector);
+			return NULL;
+		}
+	index->end = ofs;
+
+	/* Hand out the first free slot first, as a scan would. */
+	for (i = 0; i < index->free_cnt / 2; i++) {
+		off_t tmp = index->free_slots[i];
+		index->free_slots[i] = index->free_slots[index->free_cnt - i - 1];
+		index->free_slots[index->free_cnt - i - 1] = tmp;
+	}
+	index_build_cnt++;
+	return index;
+}
+
 /* Searches DIR for a file with the given NAME.
  * If successful, returns true, sets *EP to the directory entry
  * if EP is non-null, and sets *OFSP to the byte offset of the
  * directory entry if OFSP is non-null.
- * otherwise, returns false and ignores EP and OFSP. */
+ * otherwise, returns false and ignores EP and OFSP.
+ * DCACHE_LOCK must be held. */
 static bool
 lookup (const struct dir *dir, const char *name,
 		struct dir_entry *ep, off_t *ofsp) {
+	struct dir_index *index;
 	struct dir_entry e;
 	size_t ofs;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
+	index = dir_index_get (dir);
+	if (index != NULL) {
+		struct dentry *d = dentry_find (index, name);
+
+		if (d == NULL) {
+			index_miss_cnt++;
+			return false;
+		}
+		index_hit_cnt++;
+		if (ep != NULL) {
+			ep->inode_sector = d->inode_sector;
+			strlcpy (ep->name, d->name, sizeof ep->name);
+			ep->in_use = true;
+		}
+		if (ofsp != NULL)
+			*ofsp = d->ofs;
+		return true;
+	}
+
+	/* Out of memory: scan the directory. */
 	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 			ofs += sizeof e)
 		if (e.in_use && !strcmp (name, e.name)) {
@@ -109,10 +364,12 @@ dir_lookup (const struct dir *dir, const char *name,
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
+	lock_acquire (&dcache_lock);
 	if (lookup (dir, name, &e, NULL))
 		*inode = inode_open (e.inode_sector);
 	else
 		*inode = NULL;
+	lock_release (&dcache_lock);
 
 	return *inode != NULL;
 }
@@ -125,6 +382,7 @@ dir_lookup (const struct dir *dir, const char *name,
  * error occurs. */
 bool
 dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
+	struct dir_index *index;
 	struct dir_entry e;
 	off_t ofs;
 	bool success = false;
@@ -136,10 +394,32 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 	if (*name == '\0' || strlen (name) > NAME_MAX)
 		return false;
 
+	lock_acquire (&dcache_lock);
+
 	/* Check that NAME is not in use. */
 	if (lookup (dir, name, NULL, NULL))
 		goto done;
 
+	index = dir_index_find (inode_get_inumber (dir->inode));
+	if (index != NULL) {
+		/* Take a free slot, or append one. */
+		ofs = index->free_cnt > 0 ? index->free_slots[index->free_cnt - 1]
+			: index->end;
+		e.in_use = true;
+		strlcpy (e.name, name, sizeof e.name);
+		e.inode_sector = inode_sector;
+		success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+		if (success) {
+			if (ofs == index->end)
+				index->end += sizeof e;
+			else
+				index->free_cnt--;
+			if (!dentry_add (index, name, inode_sector, ofs))
+				dir_index_drop (index->sector);
+		}
+		goto done;
+	}
+
 	/* Set OFS to offset of free slot.
 	 * If there are no free slots, then it will be set to the
 	 * current end-of-file.
@@ -159,6 +439,7 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 	success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 
 done:
+	lock_release (&dcache_lock);
 	return success;
 }
 
@@ -167,6 +448,7 @@ done:
  * which occurs only if there is no file with the given NAME. */
 bool
 dir_remove (struct dir *dir, const char *name) {
+	struct dir_index *index;
 	struct dir_entry e;
 	struct inode *inode = NULL;
 	bool success = false;
@@ -175,6 +457,8 @@ dir_remove (struct dir *dir, const char *name) {
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
+	lock_acquire (&dcache_lock);
+
 	/* Find directory entry. */
 	if (!lookup (dir, name, &e, &ofs))
 		goto done;
@@ -188,12 +472,24 @@ dir_remove (struct dir *dir, const char *name) {
 	e.in_use = false;
 	if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
 		goto done;
+	index = dir_index_find (inode_get_inumber (dir->inode));
+	if (index != NULL) {
+		struct dentry *d = dentry_find (index, name);
+
+		hash_delete (&dentries, &d->hash_elem);
+		list_remove (&d->list_elem);
+		free (d);
+		if (!free_slot_push (index, ofs))
+			dir_index_drop (index->sector);
+	}
 
-	/* Remove inode. */
+	/* Remove inode, and the index if it is a directory. */
 	inode_remove (inode);
+	dir_index_drop (e.inode_sector);
 	success = true;
 
 done:
+	lock_release (&dcache_lock);
 	inode_close (inode);
 	return success;
 }
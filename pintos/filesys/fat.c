@@ -1,6 +1,7 @@
 #include "filesys/fat.h"
 #include "devices/disk.h"
 #include "filesys/filesys.h"
+#include "filesys/page_cache.h"
 #include "threads/malloc.h"
 #include "threads/synch.h"
 #include <stdio.h>
@@ -9,7 +10,7 @@
 /* Should be less than DISK_SECTOR_SIZE */
 struct fat_boot {
 	unsigned int magic;
-	unsigned int sectors_per_cluster; /* Fixed to 1 */
+	unsigned int sectors_per_cluster; /* Chosen at format time */
 	unsigned int total_sectors;
 	unsigned int fat_start;
 	unsigned int fat_sectors; /* Size of FAT in sectors. */
@@ -28,6 +29,10 @@ struct fat_fs {
 
 static struct fat_fs *fat_fs;
 
+unsigned int fat_format_cluster_sectors = SECTORS_PER_CLUSTER;
+
+static cluster_t find_run (size_t cnt);
+
 void fat_boot_create (void);
 void fat_fs_init (void);
 
@@ -131,18 +136,20 @@ fat_create (void) {
 	uint8_t *buf = calloc (1, DISK_SECTOR_SIZE);
 	if (buf == NULL)
 		PANIC ("FAT create failed due to OOM");
-	disk_write (filesys_disk, cluster_to_sector (ROOT_DIR_CLUSTER), buf);
+	page_cache_write (cluster_to_sector (ROOT_DIR_CLUSTER), buf, 0,
+			DISK_SECTOR_SIZE);
 	free (buf);
 }
 
 void
 fat_boot_create (void) {
+	unsigned int spc = fat_format_cluster_sectors;
 	unsigned int fat_sectors =
 	    (disk_size (filesys_disk) - 1)
-	    / (DISK_SECTOR_SIZE / sizeof (cluster_t) * SECTORS_PER_CLUSTER + 1) + 1;
+	    / (DISK_SECTOR_SIZE / sizeof (cluster_t) * spc + 1) + 1;
 	fat_fs->bs = (struct fat_boot){
 	    .magic = FAT_MAGIC,
-	    .sectors_per_cluster = SECTORS_PER_CLUSTER,
+	    .sectors_per_cluster = spc,
 	    .total_sectors = disk_size (filesys_disk),
 	    .fat_start = 1,
 	    .fat_sectors = fat_sectors,
@@ -150,9 +157,23 @@ fat_boot_create (void) {
 	};
 }
 
+/* Derives the FAT geometry from the boot sector.  Data clusters
+ * follow the FAT.  Cluster 0 is never used, so that it can mean
+ * "no cluster", and the FAT has one entry per data cluster plus
+ * that one. */
 void
 fat_fs_init (void) {
-	/* TODO: Your code goes here. */
+	struct fat_boot *bs = &fat_fs->bs;
+	unsigned int entries = bs->fat_sectors * (DISK_SECTOR_SIZE
+			/ sizeof (cluster_t));
+	unsigned int clusters;
+
+	fat_fs->data_start = bs->fat_start + bs->fat_sectors;
+	clusters = (bs->total_sectors - fat_fs->data_start)
+		/ bs->sectors_per_cluster;
+	fat_fs->fat_length = clusters + 1 < entries ? clusters + 1 : entries;
+	fat_fs->last_clst = ROOT_DIR_CLUSTER;
+	lock_init (&fat_fs->write_lock);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -164,30 +185,123 @@ fat_fs_init (void) {
  * Returns 0 if fails to allocate a new cluster. */
 cluster_t
 fat_create_chain (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	cluster_t new;
+
+	return fat_extend_chain (clst, 1, &new) == 1 ? new : 0;
+}
+
+/* Adds CNT clusters to the chain ending at CLST, or starts a new
+ * chain if CLST is 0, in as few contiguous runs as free space
+ * allows.  Each run continues right after the chain's last
+ * cluster if that is free, or else starts at the first free run
+ * of the clusters still needed found from last_clst on.  Stores
+ * the first cluster added in *FIRSTP and returns the number added,
+ * which is less than CNT if the disk filled up; those stay in the
+ * chain. */
+size_t
+fat_extend_chain (cluster_t clst, size_t cnt, cluster_t *firstp) {
+	size_t added;
+
+	*firstp = 0;
+	lock_acquire (&fat_fs->write_lock);
+	for (added = 0; added < cnt; added++) {
+		cluster_t new;
+
+		if (clst != 0 && clst + 1 < fat_fs->fat_length
+				&& fat_fs->fat[clst + 1] == 0)
+			new = clst + 1;
+		else if ((new = find_run (cnt - added)) == 0)
+			break;
+		fat_fs->fat[new] = EOChain;
+		if (clst != 0)
+			fat_fs->fat[clst] = new;
+		if (*firstp == 0)
+			*firstp = new;
+		clst = new;
+	}
+	if (added > 0)
+		fat_fs->last_clst = clst;
+	lock_release (&fat_fs->write_lock);
+	return added;
+}
+
+/* Returns the first cluster of the first run of CNT free clusters
+ * found going around the FAT from last_clst, or of the longest
+ * run if there is none that long, or 0 if no cluster is free.
+ * The write lock must be held. */
+static cluster_t
+find_run (size_t cnt) {
+	cluster_t best = 0, start = 0;
+	size_t best_len = 0, len = 0;
+	unsigned int i;
+
+	for (i = 1; i < fat_fs->fat_length; i++) {
+		cluster_t c = (fat_fs->last_clst + i - 1) % (fat_fs->fat_length - 1) + 1;
+
+		/* Runs do not wrap past the end of the FAT. */
+		if (fat_fs->fat[c] != 0 || c == 1)
+			len = 0;
+		if (fat_fs->fat[c] != 0)
+			continue;
+		if (len++ == 0)
+			start = c;
+		if (len >= cnt)
+			return start;
+		if (len > best_len) {
+			best = start;
+			best_len = len;
+		}
+	}
+	return best;
 }
 
 /* Remove the chain of clusters starting from CLST.
  * If PCLST is 0, assume CLST as the start of the chain. */
 void
 fat_remove_chain (cluster_t clst, cluster_t pclst) {
-	/* TODO: Your code goes here. */
+	lock_acquire (&fat_fs->write_lock);
+	if (pclst != 0)
+		fat_fs->fat[pclst] = EOChain;
+	while (clst != 0 && clst != EOChain) {
+		cluster_t next = fat_fs->fat[clst];
+
+		ASSERT (clst < fat_fs->fat_length);
+		fat_fs->fat[clst] = 0;
+		clst = next;
+	}
+	lock_release (&fat_fs->write_lock);
 }
 
 /* Update a value in the FAT table. */
 void
 fat_put (cluster_t clst, cluster_t val) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst != 0 && clst < fat_fs->fat_length);
+	fat_fs->fat[clst] = val;
 }
 
 /* Fetch a value in the FAT table. */
 cluster_t
 fat_get (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst != 0 && clst < fat_fs->fat_length);
+	return fat_fs->fat[clst];
 }
 
 /* Covert a cluster # to a sector number. */
 disk_sector_t
 cluster_to_sector (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst != 0 && clst < fat_fs->fat_length);
+	return fat_fs->data_start + (clst - 1) * fat_fs->bs.sectors_per_cluster;
+}
+
+/* Returns the number of sectors in a cluster. */
+unsigned int
+fat_cluster_sectors (void) {
+	return fat_fs->bs.sectors_per_cluster;
+}
+
+/* Converts SECTOR, the first of a cluster, to its cluster #. */
+cluster_t
+sector_to_cluster (disk_sector_t sector) {
+	ASSERT (sector >= fat_fs->data_start);
+	return (sector - fat_fs->data_start) / fat_fs->bs.sectors_per_cluster + 1;
 }
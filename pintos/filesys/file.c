@@ -1,7 +1,10 @@
 #include "filesys/file.h"
 #include <debug.h>
+#include "devices/disk.h"
 #include "filesys/inode.h"
+#include "filesys/page_cache.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 
 /* An open file. */
 struct file {
@@ -9,23 +12,49 @@ struct file {
 	off_t pos;                  /* Current position. */
 	bool deny_write;            /* Has file_deny_write() been called? */
 	int ref_cnt;       
+
+	/* Readahead state; see file_readahead(). */
+	off_t ra_next;              /* Where a sequential read would start. */
+	off_t ra_window;            /* Bytes to read ahead, 0 if random. */
+	off_t ra_end;               /* End of what was already read ahead. */
 };
 
+/* Readahead window bounds.  The window starts at RA_MIN bytes on
+ * the second sequential read and doubles on each one after, up to
+ * half the buffer cache, so that what is read ahead is not evicted
+ * before it is used. */
+#define RA_MIN (8 * DISK_SECTOR_SIZE)
+#define RA_MAX (PAGE_CACHE_SECTORS / 2 * DISK_SECTOR_SIZE)
+
+static void file_readahead (struct file *file, off_t ofs, off_t bytes);
+
+/* Cache of open files. */
+static struct kmem_cache *file_cache;
+
+/* Initializes the file module. */
+void
+file_init (void) {
+	file_cache = kmem_cache_create ("file", sizeof (struct file), NULL);
+}
+
 /* Opens a file for the given INODE, of which it takes ownership,
  * and returns the new file.  Returns a null pointer if an
  * allocation fails or if INODE is null. */
 struct file *
 file_open (struct inode *inode) {
-	struct file *file = calloc (1, sizeof *file);
+	struct file *file = kmem_cache_alloc (file_cache);
 	if (inode != NULL && file != NULL) {
 		file->inode = inode;
 		file->pos = 0;
 		file->deny_write = false;
 		file->ref_cnt = 1;
+		file->ra_next = 0;
+		file->ra_window = 0;
+		file->ra_end = 0;
 		return file;
 	} else {
 		inode_close (inode);
-		free (file);
+		kmem_cache_free (file_cache, file);
 		return NULL;
 	}
 }
@@ -56,7 +85,7 @@ file_close (struct file *file) {
 	if (file != NULL && --file->ref_cnt == 0) {
 		file_allow_write (file);
 		inode_close (file->inode);
-		free (file);
+		kmem_cache_free (file_cache, file);
 	}
 }
 
@@ -74,6 +103,7 @@ file_get_inode (struct file *file) {
 off_t
 file_read (struct file *file, void *buffer, off_t size) {
 	off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+	file_readahead (file, file->pos, bytes_read);
 	file->pos += bytes_read;
 	return bytes_read;
 }
@@ -85,7 +115,41 @@ file_read (struct file *file, void *buffer, off_t size) {
  * The file's current position is unaffected. */
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) {
-	return inode_read_at (file->inode, buffer, size, file_ofs);
+	off_t bytes_read = inode_read_at (file->inode, buffer, size, file_ofs);
+	file_readahead (file, file_ofs, bytes_read);
+	return bytes_read;
+}
+
+/* Notes that BYTES were just read at OFS in FILE, and reads ahead
+ * in the background while FILE is read sequentially.  A read that
+ * starts where the last one ended grows the window; any other read
+ * closes it.  Only the part of the window not already requested
+ * is queued, so reading in small pieces costs little. */
+static void
+file_readahead (struct file *file, off_t ofs, off_t bytes) {
+	off_t end = ofs + bytes;
+	off_t start;
+
+	if (bytes == 0)
+		return;
+	if (ofs == file->ra_next && ofs != 0) {
+		if (file->ra_window == 0)
+			file->ra_window = RA_MIN;
+		else if (file->ra_window < RA_MAX)
+			file->ra_window *= 2;
+	} else {
+		file->ra_window = 0;
+		file->ra_end = 0;
+	}
+	file->ra_next = end;
+	if (file->ra_window == 0)
+		return;
+
+	start = file->ra_end > end ? file->ra_end : end;
+	if (start < end + file->ra_window) {
+		inode_readahead (file->inode, start, end + file->ra_window - start);
+		file->ra_end = end + file->ra_window;
+	}
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
@@ -3,9 +3,12 @@
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include "filesys/fat.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/page_cache.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -13,7 +16,9 @@
 /* On-disk inode.
  * Must be exactly DISK_SECTOR_SIZE bytes long. */
 struct inode_disk {
-	disk_sector_t start;                /* First data sector. */
+	disk_sector_t start;                /* First data sector, or with
+	                                       EFILESYS the first cluster of
+	                                       the chain, 0 if empty. */
 	off_t length;                       /* File size in bytes. */
 	unsigned magic;                     /* Magic number. */
 	uint32_t unused[125];               /* Not used. */
@@ -26,6 +31,19 @@ bytes_to_sectors (off_t size) {
 	return DIV_ROUND_UP (size, DISK_SECTOR_SIZE);
 }
 
+#ifdef EFILESYS
+/* Bytes in a cluster. */
+#define CLUSTER_BYTES (fat_cluster_sectors () * DISK_SECTOR_SIZE)
+
+/* A run of clusters that follow each other both in a file and on
+ * disk. */
+struct extent {
+	cluster_t index;                    /* Cluster index in the file. */
+	cluster_t clst;                     /* First cluster on disk. */
+	cluster_t cnt;                      /* Clusters in the run. */
+};
+#endif
+
 /* In-memory inode. */
 struct inode {
 	struct list_elem elem;              /* Element in inode list. */
@@ -34,29 +52,203 @@ struct inode {
 	bool removed;                       /* True if deleted, false otherwise. */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
 	struct inode_disk data;             /* Inode content. */
+#ifdef EFILESYS
+	/* Extent map of the part of the cluster chain walked so far,
+	 * so that finding the cluster for an offset is a binary search
+	 * rather than a walk from the start of the chain. */
+	struct extent *extents;             /* In file order. */
+	size_t extent_cnt;
+	size_t extent_cap;
+	cluster_t walk_next;                /* First cluster not in the map,
+	                                       or 0 once it reaches the end. */
+#endif
 };
 
+#ifdef EFILESYS
+static cluster_t extent_lookup (struct inode *inode, cluster_t idx);
+#endif
+
 /* Returns the disk sector that contains byte offset POS within
  * INODE.
  * Returns -1 if INODE does not contain data for a byte at offset
  * POS. */
 static disk_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) {
+byte_to_sector (struct inode *inode, off_t pos) {
 	ASSERT (inode != NULL);
-	if (pos < inode->data.length)
-		return inode->data.start + pos / DISK_SECTOR_SIZE;
-	else
+	if (pos >= inode->data.length)
 		return -1;
+#ifdef EFILESYS
+	return cluster_to_sector (extent_lookup (inode, pos / CLUSTER_BYTES))
+		+ pos % CLUSTER_BYTES / DISK_SECTOR_SIZE;
+#else
+	return inode->data.start + pos / DISK_SECTOR_SIZE;
+#endif
+}
+
+#ifdef EFILESYS
+/* Returns the number of clusters in the chain of a file SIZE
+ * bytes long. */
+static inline size_t
+bytes_to_clusters (off_t size) {
+	return DIV_ROUND_UP (size, CLUSTER_BYTES);
+}
+
+/* Returns the number of clusters in INODE's extent map. */
+static cluster_t
+extent_end (const struct inode *inode) {
+	const struct extent *last;
+
+	if (inode->extent_cnt == 0)
+		return 0;
+	last = &inode->extents[inode->extent_cnt - 1];
+	return last->index + last->cnt;
+}
+
+/* Adds CLST to the end of INODE's extent map, as the file's next
+ * cluster.  Returns false if out of memory. */
+static bool
+extent_append (struct inode *inode, cluster_t clst) {
+	if (inode->extent_cnt > 0) {
+		struct extent *last = &inode->extents[inode->extent_cnt - 1];
+		if (last->clst + last->cnt == clst) {
+			last->cnt++;
+			return true;
+		}
+	}
+	if (inode->extent_cnt == inode->extent_cap) {
+		size_t cap = inode->extent_cap ? inode->extent_cap * 2 : 4;
+		struct extent *extents = realloc (inode->extents,
+				cap * sizeof *extents);
+		if (extents == NULL)
+			return false;
+		inode->extents = extents;
+		inode->extent_cap = cap;
+	}
+	inode->extents[inode->extent_cnt++] = (struct extent) {
+		.index = extent_end (inode),
+		.clst = clst,
+		.cnt = 1,
+	};
+	return true;
+}
+
+/* Empties INODE's extent map, so that it is built again from the
+ * start of the chain as needed. */
+static void
+extent_reset (struct inode *inode) {
+	free (inode->extents);
+	inode->extents = NULL;
+	inode->extent_cnt = inode->extent_cap = 0;
+	inode->walk_next = inode->data.start;
+}
+
+/* Returns the disk cluster holding cluster IDX of INODE's data,
+ * which must exist.  The chain is walked only past the part
+ * already mapped, and each cluster is walked once while INODE
+ * stays open. */
+static cluster_t
+extent_lookup (struct inode *inode, cluster_t idx) {
+	size_t lo = 0, hi;
+
+	while (idx >= extent_end (inode)) {
+		cluster_t clst = inode->walk_next;
+
+		ASSERT (clst != 0);
+		if (!extent_append (inode, clst)) {
+			/* Out of memory: walk from the start this once. */
+			clst = inode->data.start;
+			while (idx-- > 0)
+				clst = fat_get (clst);
+			return clst;
+		}
+		clst = fat_get (clst);
+		inode->walk_next = clst != EOChain ? clst : 0;
+	}
+
+	hi = inode->extent_cnt;
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		struct extent *e = &inode->extents[mid];
+
+		if (idx < e->index)
+			hi = mid;
+		else if (idx >= e->index + e->cnt)
+			lo = mid + 1;
+		else
+			return e->clst + (idx - e->index);
+	}
+	NOT_REACHED ();
 }
 
+/* Zeroes the sectors of cluster CLST. */
+static void
+cluster_zero (cluster_t clst) {
+	static char zeros[DISK_SECTOR_SIZE];
+	unsigned int i;
+
+	for (i = 0; i < fat_cluster_sectors (); i++)
+		page_cache_write (cluster_to_sector (clst) + i, zeros, 0,
+				DISK_SECTOR_SIZE);
+}
+
+/* Creates a chain of CNT zeroed clusters and stores its first
+ * cluster, or 0 if CNT is 0, in *STARTP.  Returns false, with
+ * nothing allocated, if the disk is full. */
+static bool
+chain_create (size_t cnt, cluster_t *startp) {
+	cluster_t clst;
+	size_t i;
+
+	if (fat_extend_chain (0, cnt, startp) < cnt) {
+		if (*startp != 0)
+			fat_remove_chain (*startp, 0);
+		*startp = 0;
+		return false;
+	}
+	for (clst = *startp, i = 0; i < cnt; i++, clst = fat_get (clst))
+		cluster_zero (clst);
+	return true;
+}
+
+/* Extends INODE's chain to CNT clusters, zeroed, keeping the
+ * extent map up to date.  The new clusters are allocated together,
+ * so they come out in long contiguous runs.  Returns the number of
+ * clusters in the chain after, which is less than CNT if the disk
+ * filled up. */
+static size_t
+inode_grow (struct inode *inode, size_t cnt) {
+	size_t have = bytes_to_clusters (inode->data.length);
+	cluster_t last = have > 0 ? extent_lookup (inode, have - 1) : 0;
+	cluster_t clst;
+	size_t added, i;
+
+	if (have >= cnt)
+		return have;
+	added = fat_extend_chain (last, cnt - have, &clst);
+	if (added > 0 && last == 0)
+		inode->data.start = inode->walk_next = clst;
+	for (i = 0; i < added; i++, clst = fat_get (clst)) {
+		cluster_zero (clst);
+		/* A map still being walked picks the cluster up later. */
+		if (inode->walk_next == 0 && !extent_append (inode, clst))
+			extent_reset (inode);
+	}
+	return have + added;
+}
+#endif
+
 /* List of open inodes, so that opening a single inode twice
  * returns the same `struct inode'. */
 static struct list open_inodes;
 
+/* Cache of in-memory inodes. */
+static struct kmem_cache *inode_cache;
+
 /* Initializes the inode module. */
 void
 inode_init (void) {
 	list_init (&open_inodes);
+	inode_cache = kmem_cache_create ("inode", sizeof (struct inode), NULL);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -77,20 +269,28 @@ inode_create (disk_sector_t sector, off_t length) {
 
 	disk_inode = calloc (1, sizeof *disk_inode);
 	if (disk_inode != NULL) {
-		size_t sectors = bytes_to_sectors (length);
 		disk_inode->length = length;
 		disk_inode->magic = INODE_MAGIC;
+#ifdef EFILESYS
+		if (chain_create (bytes_to_clusters (length), &disk_inode->start)) {
+			page_cache_write (sector, disk_inode, 0, DISK_SECTOR_SIZE);
+			success = true;
+		}
+#else
+		size_t sectors = bytes_to_sectors (length);
 		if (free_map_allocate (sectors, &disk_inode->start)) {
-			disk_write (filesys_disk, sector, disk_inode);
+			page_cache_write (sector, disk_inode, 0, DISK_SECTOR_SIZE);
 			if (sectors > 0) {
 				static char zeros[DISK_SECTOR_SIZE];
 				size_t i;
 
 				for (i = 0; i < sectors; i++) 
-					disk_write (filesys_disk, disk_inode->start + i, zeros); 
+					page_cache_write (disk_inode->start + i, zeros, 0,
+							DISK_SECTOR_SIZE); 
 			}
 			success = true; 
 		} 
+#endif
 		free (disk_inode);
 	}
 	return success;
@@ -115,7 +315,7 @@ inode_open (disk_sector_t sector) {
 	}
 
 	/* Allocate memory. */
-	inode = malloc (sizeof *inode);
+	inode = kmem_cache_alloc (inode_cache);
 	if (inode == NULL)
 		return NULL;
 
@@ -125,7 +325,12 @@ inode_open (disk_sector_t sector) {
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
-	disk_read (filesys_disk, inode->sector, &inode->data);
+	page_cache_read (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+#ifdef EFILESYS
+	inode->extents = NULL;
+	inode->extent_cnt = inode->extent_cap = 0;
+	inode->walk_next = inode->data.start;
+#endif
 	return inode;
 }
 
@@ -159,12 +364,21 @@ inode_close (struct inode *inode) {
 
 		/* Deallocate blocks if removed. */
 		if (inode->removed) {
+#ifdef EFILESYS
+			fat_remove_chain (sector_to_cluster (inode->sector), 0);
+			if (inode->data.start != 0)
+				fat_remove_chain (inode->data.start, 0);
+#else
 			free_map_release (inode->sector, 1);
 			free_map_release (inode->data.start,
 					bytes_to_sectors (inode->data.length)); 
+#endif
 		}
+#ifdef EFILESYS
+		free (inode->extents);
+#endif
 
-		free (inode); 
+		kmem_cache_free (inode_cache, inode);
 	}
 }
 
@@ -183,7 +397,6 @@ off_t
 inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 	uint8_t *buffer = buffer_;
 	off_t bytes_read = 0;
-	uint8_t *bounce = NULL;
 
 	while (size > 0) {
 		/* Disk sector to read, starting byte offset within sector. */
@@ -200,46 +413,62 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Read full sector directly into caller's buffer. */
-			disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
-		} else {
-			/* Read sector into bounce buffer, then partially copy
-			 * into caller's buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-			disk_read (filesys_disk, sector_idx, bounce);
-			memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-		}
+		page_cache_read (sector_idx, buffer + bytes_read, sector_ofs,
+				chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_read += chunk_size;
 	}
-	free (bounce);
 
 	return bytes_read;
 }
 
+/* Asks the buffer cache to read the sectors of INODE holding the
+ * SIZE bytes at OFFSET in the background, stopping at the end of
+ * the file. */
+void
+inode_readahead (struct inode *inode, off_t offset, off_t size) {
+	off_t end = offset + size;
+	off_t pos;
+
+	if (end > inode_length (inode))
+		end = inode_length (inode);
+	for (pos = ROUND_DOWN (offset, DISK_SECTOR_SIZE); pos < end;
+			pos += DISK_SECTOR_SIZE)
+		page_cache_prefetch (byte_to_sector (inode, pos));
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
  * Returns the number of bytes actually written, which may be
  * less than SIZE if end of file is reached or an error occurs.
- * (Normally a write at end of file would extend the inode, but
- * growth is not yet implemented.) */
+ * With EFILESYS a write past the end of file extends the inode,
+ * reading as zeros in any gap; otherwise growth is not
+ * implemented. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		off_t offset) {
 	const uint8_t *buffer = buffer_;
 	off_t bytes_written = 0;
-	uint8_t *bounce = NULL;
 
 	if (inode->deny_write_cnt)
 		return 0;
 
+#ifdef EFILESYS
+	if (size > 0 && offset + size > inode->data.length) {
+		off_t room = inode_grow (inode, bytes_to_clusters (offset + size))
+			* CLUSTER_BYTES;
+		off_t length = offset + size < room ? offset + size : room;
+
+		if (length > inode->data.length) {
+			inode->data.length = length;
+			page_cache_write (inode->sector, &inode->data, 0,
+					DISK_SECTOR_SIZE);
+		}
+	}
+#endif
+
 	while (size > 0) {
 		/* Sector to write, starting byte offset within sector. */
 		disk_sector_t sector_idx = byte_to_sector (inode, offset);
@@ -255,34 +484,15 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Write full sector directly to disk. */
-			disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
-		} else {
-			/* We need a bounce buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-
-			/* If the sector contains data before or after the chunk
-			   we're writing, then we need to read in the sector
-			   first.  Otherwise we start with a sector of all zeros. */
-			if (sector_ofs > 0 || chunk_size < sector_left) 
-				disk_read (filesys_disk, sector_idx, bounce);
-			else
-				memset (bounce, 0, DISK_SECTOR_SIZE);
-			memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-			disk_write (filesys_disk, sector_idx, bounce); 
-		}
+		/* The cache reads in the rest of a partly written sector. */
+		page_cache_write (sector_idx, buffer + bytes_written, sector_ofs,
+				chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_written += chunk_size;
 	}
-	free (bounce);
 
 	return bytes_written;
 }
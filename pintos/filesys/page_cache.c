@@ -1,6 +1,28 @@
-/* page_cache.c: Implementation of Page Cache (Buffer Cache). */
+/* page_cache.c: Implementation of Page Cache (Buffer Cache).
+ *
+ * Sectors of the file system disk are kept in PAGE_CACHE_SECTORS
+ * buffers, replaced by the clock algorithm.  A write only dirties
+ * its buffer.  The buffer goes to disk when it is evicted, when
+ * kflushd finds it has been dirty for PAGE_CACHE_FLUSH_AGE ms, or
+ * at filesys_done().  kworkerd reads ahead the sectors that
+ * sequential file reads are about to need; see file_readahead().
+ *
+ * One lock covers the whole cache, but it is dropped during disk
+ * I/O.  An entry being read or written is marked busy meanwhile,
+ * and anyone who needs it waits on that entry's io_done until the
+ * I/O is done, so a buffer never changes under a reader. */
 
 #include "vm/vm.h"
+#include "filesys/page_cache.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/disk.h"
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
 static bool page_cache_readahead (struct page *page, void *kva);
 static bool page_cache_writeback (struct page *page);
 static void page_cache_destroy (struct page *page);
@@ -15,10 +37,50 @@ static const struct page_operations page_cache_op = {
 
 tid_t page_cache_workerd;
 
-/* The initializer of file vm */
+/* A cached sector. */
+struct cache_entry {
+	disk_sector_t sector;
+	bool valid;                 /* Holds SECTOR. */
+	bool dirty;                 /* Differs from the disk. */
+	bool accessed;              /* Used since the clock hand passed. */
+	bool prefetched;            /* Read ahead and not used yet. */
+	bool busy;                  /* Disk I/O in progress. */
+	struct condition io_done;   /* Signaled when BUSY is cleared. */
+	int64_t dirty_since;        /* Tick it became dirty. */
+	uint8_t data[DISK_SECTOR_SIZE];
+};
+
+static struct cache_entry cache[PAGE_CACHE_SECTORS];
+static size_t clock_hand;
+static size_t dirty_cnt;            /* Dirty entries. */
+static struct lock cache_lock;      /* Protects all of the above. */
+
+/* Sectors waiting to be read ahead, a ring buffer under
+ * cache_lock.  It holds the largest file readahead window;
+ * requests that find it full are dropped. */
+#define PREFETCH_MAX (PAGE_CACHE_SECTORS / 2)
+static disk_sector_t prefetch_queue[PREFETCH_MAX];
+static size_t prefetch_head, prefetch_cnt;
+
+static struct semaphore prefetch_sema;  /* Up once per queued sector. */
+static struct semaphore flush_sema;     /* Up when the cache gets dirty. */
+
+/* Statistics. */
+static long long hit_cnt;
+static long long miss_cnt;
+static long long prefetch_read_cnt;
+static long long writeback_cnt;
+static long long ra_hit_cnt;        /* Reads served by readahead. */
+static long long ra_miss_cnt;       /* Reads that waited on the disk. */
+static long long ra_waste_cnt;      /* Read ahead, evicted unused. */
+
+static void page_cache_kworkerd (void *aux);
+static void page_cache_kflushd (void *aux);
+
+/* The initializer of file vm.  Sector caching does not depend on
+ * VM; it is set up by filesys_init() through page_cache_init(). */
 void
 pagecache_init (void) {
-	/* TODO: Create a worker daemon for page cache with page_cache_kworkerd */
 }
 
 /* Initialize the page cache */
@@ -26,17 +88,21 @@ bool
 page_cache_initializer (struct page *page, enum vm_type type, void *kva) {
 	/* Set up the handler */
 	page->operations = &page_cache_op;
-
+	return true;
 }
 
-/* Utilze the Swap in mechanism to implement readhead */
+/* Utilze the Swap in mechanism to implement readhead.
+ * No VM_PAGE_CACHE pages are created, since file data is cached
+ * by sector, so there is nothing to read. */
 static bool
 page_cache_readahead (struct page *page, void *kva) {
+	return false;
 }
 
 /* Utilze the Swap out mechanism to implement writeback */
 static bool
 page_cache_writeback (struct page *page) {
+	return false;
 }
 
 /* Destory the page_cache. */
@@ -44,7 +110,276 @@ static void
 page_cache_destroy (struct page *page) {
 }
 
-/* Worker thread for page cache */
+/* Sets up the sector cache and starts its worker threads. */
+void
+page_cache_init (void) {
+	size_t i;
+
+	lock_init (&cache_lock);
+	for (i = 0; i < PAGE_CACHE_SECTORS; i++)
+		cond_init (&cache[i].io_done);
+	sema_init (&prefetch_sema, 0);
+	sema_init (&flush_sema, 0);
+	page_cache_workerd = thread_create ("kworkerd", PRI_DEFAULT,
+			page_cache_kworkerd, NULL);
+	thread_create ("kflushd", PRI_DEFAULT, page_cache_kflushd, NULL);
+}
+
+/* Returns the entry holding SECTOR, or NULL.  CACHE_LOCK must be
+ * held. */
+static struct cache_entry *
+cache_lookup (disk_sector_t sector) {
+	size_t i;
+
+	for (i = 0; i < PAGE_CACHE_SECTORS; i++)
+		if (cache[i].valid && cache[i].sector == sector)
+			return &cache[i];
+	return NULL;
+}
+
+/* Waits until no disk I/O is in progress on E.  CACHE_LOCK must be
+ * held. */
 static void
-page_cache_kworkerd (void *aux) {
+cache_wait (struct cache_entry *e) {
+	while (e->busy)
+		cond_wait (&e->io_done, &cache_lock);
+}
+
+/* Marks E's disk I/O done and wakes those waiting on it.
+ * CACHE_LOCK must be held. */
+static void
+cache_io_done (struct cache_entry *e) {
+	e->busy = false;
+	cond_broadcast (&e->io_done, &cache_lock);
+}
+
+/* Writes E to disk if it is dirty and not already under I/O.
+ * CACHE_LOCK is released during the write.  CACHE_LOCK must be
+ * held. */
+static void
+cache_clean (struct cache_entry *e) {
+	if (!e->dirty || e->busy)
+		return;
+	e->dirty = false;
+	dirty_cnt--;
+	writeback_cnt++;
+	e->busy = true;
+	lock_release (&cache_lock);
+	disk_write (filesys_disk, e->sector, e->data);
+	lock_acquire (&cache_lock);
+	cache_io_done (e);
+}
+
+/* Returns the first entry not used since the clock hand last
+ * passed, which may still be dirty, or NULL if the hand went twice
+ * around finding every entry busy.  CACHE_LOCK must be held. */
+static struct cache_entry *
+cache_evict (void) {
+	size_t i;
+
+	for (i = 0; i < 2 * PAGE_CACHE_SECTORS; i++) {
+		struct cache_entry *e = &cache[clock_hand];
+
+		clock_hand = (clock_hand + 1) % PAGE_CACHE_SECTORS;
+		if (!e->valid)
+			return e;
+		if (e->busy)
+			continue;
+		if (e->accessed)
+			e->accessed = false;
+		else
+			return e;
+	}
+	return NULL;
+}
+
+/* Returns the entry for SECTOR, taking one over if SECTOR is not
+ * cached, with no I/O in progress on it.  A new entry is read from
+ * disk if READ; otherwise the caller is about to overwrite all of
+ * it.  For PREFETCH, the read counts as read ahead rather than as
+ * a miss, and a hit is not counted.  CACHE_LOCK must be held; it
+ * is released during disk I/O. */
+static struct cache_entry *
+cache_get (disk_sector_t sector, bool read, bool prefetch) {
+	struct cache_entry *e;
+
+	for (;;) {
+		e = cache_lookup (sector);
+		if (e != NULL && e->busy) {
+			/* It may hold another sector once the I/O is done. */
+			cache_wait (e);
+			continue;
+		}
+		if (e != NULL) {
+			if (!prefetch)
+				hit_cnt++;
+			return e;
+		}
+		e = cache_evict ();
+		if (e == NULL) {
+			cache_wait (&cache[clock_hand]);
+			continue;
+		}
+		if (!e->dirty)
+			break;
+
+		/* Others may cache SECTOR while the victim is written. */
+		cache_clean (e);
+		if (cache_lookup (sector) == NULL)
+			break;
+	}
+
+	if (e->valid && e->prefetched)
+		ra_waste_cnt++;
+	if (prefetch)
+		prefetch_read_cnt++;
+	else
+		miss_cnt++;
+	e->sector = sector;
+	e->valid = true;
+	e->dirty = false;
+	e->accessed = false;
+	e->prefetched = prefetch;
+	if (read) {
+		e->busy = true;
+		lock_release (&cache_lock);
+		disk_read (filesys_disk, sector, e->data);
+		lock_acquire (&cache_lock);
+		cache_io_done (e);
+	}
+	return e;
+}
+
+/* Copies SIZE bytes at offset OFS of SECTOR into BUFFER. */
+void
+page_cache_read (disk_sector_t sector, void *buffer, off_t ofs,
+		size_t size) {
+	struct cache_entry *e;
+
+	ASSERT (ofs >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+	lock_acquire (&cache_lock);
+	e = cache_lookup (sector);
+	if (e == NULL)
+		ra_miss_cnt++;
+	else if (e->prefetched)
+		ra_hit_cnt++;
+	e = cache_get (sector, true, false);
+	memcpy (buffer, e->data + ofs, size);
+	e->accessed = true;
+	e->prefetched = false;
+	lock_release (&cache_lock);
+}
+
+/* Copies SIZE bytes from BUFFER to offset OFS of SECTOR.  The
+ * sector reaches the disk later. */
+void
+page_cache_write (disk_sector_t sector, const void *buffer, off_t ofs,
+		size_t size) {
+	struct cache_entry *e;
+
+	ASSERT (ofs >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+	lock_acquire (&cache_lock);
+	e = cache_get (sector, size < DISK_SECTOR_SIZE, false);
+	memcpy (e->data + ofs, buffer, size);
+	e->accessed = true;
+	e->prefetched = false;
+	if (!e->dirty) {
+		e->dirty = true;
+		e->dirty_since = timer_ticks ();
+		if (dirty_cnt++ == 0)
+			sema_up (&flush_sema);
+	}
+	lock_release (&cache_lock);
+}
+
+/* Asks kworkerd to read SECTOR into the cache, unless it is
+ * already there or waiting. */
+void
+page_cache_prefetch (disk_sector_t sector) {
+	size_t i;
+
+	lock_acquire (&cache_lock);
+	if (prefetch_cnt == PREFETCH_MAX || cache_lookup (sector) != NULL) {
+		lock_release (&cache_lock);
+		return;
+	}
+	for (i = 0; i < prefetch_cnt; i++)
+		if (prefetch_queue[(prefetch_head + i) % PREFETCH_MAX] == sector) {
+			lock_release (&cache_lock);
+			return;
+		}
+	prefetch_queue[(prefetch_head + prefetch_cnt++) % PREFETCH_MAX] = sector;
+	lock_release (&cache_lock);
+	sema_up (&prefetch_sema);
+}
+
+/* Writes every dirty sector to disk. */
+void
+page_cache_flush (void) {
+	size_t i;
+
+	lock_acquire (&cache_lock);
+	for (i = 0; i < PAGE_CACHE_SECTORS; i++) {
+		cache_wait (&cache[i]);
+		if (cache[i].valid)
+			cache_clean (&cache[i]);
+	}
+	lock_release (&cache_lock);
+}
+
+/* Prints cache statistics. */
+void
+page_cache_print_stats (void) {
+	printf ("Buffer cache: %lld hits, %lld misses, %lld sectors read ahead, "
+			"%lld written back\n",
+			hit_cnt, miss_cnt, prefetch_read_cnt, writeback_cnt);
+	printf ("Readahead: %lld hits, %lld misses, %lld wasted\n",
+			ra_hit_cnt, ra_miss_cnt, ra_waste_cnt);
+}
+
+/* Worker thread for page cache.  Reads ahead the sectors queued by
+ * page_cache_prefetch(), with CACHE_LOCK released during each
+ * read. */
+static void
+page_cache_kworkerd (void *aux UNUSED) {
+	for (;;) {
+		disk_sector_t sector;
+
+		sema_down (&prefetch_sema);
+		lock_acquire (&cache_lock);
+		sector = prefetch_queue[prefetch_head];
+		prefetch_head = (prefetch_head + 1) % PREFETCH_MAX;
+		prefetch_cnt--;
+		cache_get (sector, true, true);
+		lock_release (&cache_lock);
+	}
+}
+
+/* Write-behind thread.  While the cache holds dirty sectors, wakes
+ * every PAGE_CACHE_FLUSH_PERIOD ms and writes back those dirty for
+ * PAGE_CACHE_FLUSH_AGE ms, so a sector written over and over goes
+ * to disk once per period of age rather than once per write. */
+static void
+page_cache_kflushd (void *aux UNUSED) {
+	for (;;) {
+		size_t left;
+
+		sema_down (&flush_sema);
+		do {
+			int64_t due;
+			size_t i;
+
+			timer_msleep (PAGE_CACHE_FLUSH_PERIOD);
+			due = timer_ticks () - PAGE_CACHE_FLUSH_AGE * TIMER_FREQ / 1000;
+			lock_acquire (&cache_lock);
+			for (i = 0; i < PAGE_CACHE_SECTORS; i++)
+				if (cache[i].valid && cache[i].dirty
+						&& cache[i].dirty_since <= due)
+					cache_clean (&cache[i]);
+			left = dirty_cnt;
+			lock_release (&cache_lock);
+		} while (left > 0);
+	}
 }
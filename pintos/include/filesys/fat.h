@@ -14,10 +14,14 @@ typedef uint32_t cluster_t;  /* Index of a cluster within FAT. */
 #define EOChain 0x0FFFFFFF   /* End of cluster chain */
 
 /* Sectors of FAT information. */
-#define SECTORS_PER_CLUSTER 1 /* Number of sectors per cluster */
+#define SECTORS_PER_CLUSTER 1 /* Default sectors per cluster */
+#define MAX_SECTORS_PER_CLUSTER 64
 #define FAT_BOOT_SECTOR 0     /* FAT boot sector. */
 #define ROOT_DIR_CLUSTER 1    /* Cluster for the root directory */
 
+/* Sectors per cluster for a disk formatted now, set by -f. */
+extern unsigned int fat_format_cluster_sectors;
+
 void fat_init (void);
 void fat_open (void);
 void fat_close (void);
@@ -31,8 +35,11 @@ void fat_remove_chain (
     cluster_t clst, /* Cluster # to be removed */
     cluster_t pclst /* Previous cluster of clst, 0: clst is the start of chain */
 );
+size_t fat_extend_chain (cluster_t clst, size_t cnt, cluster_t *firstp);
 cluster_t fat_get (cluster_t clst);
 void fat_put (cluster_t clst, cluster_t val);
 disk_sector_t cluster_to_sector (cluster_t clst);
+cluster_t sector_to_cluster (disk_sector_t sector);
+unsigned int fat_cluster_sectors (void);
 
 #endif /* filesys/fat.h */
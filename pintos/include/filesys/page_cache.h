@@ -1,12 +1,30 @@
 #ifndef FILESYS_PAGE_CACHE_H
 #define FILESYS_PAGE_CACHE_H
-#include "vm/vm.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/disk.h"
+#include "filesys/off_t.h"
 
 struct page;
 enum vm_type;
 
 struct page_cache {};
 
+/* Sectors held by the buffer cache. */
+#define PAGE_CACHE_SECTORS 128
+
+/* Milliseconds a cached sector may stay dirty before it is written
+ * back, and between write-behind passes. */
+#define PAGE_CACHE_FLUSH_AGE 3000
+#define PAGE_CACHE_FLUSH_PERIOD 1000
+
 void page_cache_init (void);
 bool page_cache_initializer (struct page *page, enum vm_type type, void *kva);
+void page_cache_read (disk_sector_t sector, void *buffer, off_t ofs,
+		size_t size);
+void page_cache_write (disk_sector_t sector, const void *buffer, off_t ofs,
+		size_t size);
+void page_cache_prefetch (disk_sector_t sector);
+void page_cache_flush (void);
+void page_cache_print_stats (void);
 #endif
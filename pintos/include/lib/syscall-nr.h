@@ -36,6 +36,22 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Extra for Project 3 */
+	SYS_MADVISE,                /* Advise on use of a memory range. */
+	SYS_MSYNC,                  /* Write back a memory mapping. */
 };
 
+/* Advice for SYS_MADVISE. */
+#define MADV_NORMAL 0               /* No special treatment. */
+#define MADV_RANDOM 1               /* Expect random access. */
+#define MADV_SEQUENTIAL 2           /* Expect sequential access. */
+#define MADV_WILLNEED 3             /* Will need these pages soon. */
+#define MADV_DONTNEED 4             /* Do not need these pages now. */
+
+/* Flags for SYS_MSYNC. */
+#define MS_ASYNC 1                  /* Schedule the write-back. */
+#define MS_INVALIDATE 2             /* Make other mappings see it. */
+#define MS_SYNC 4                   /* Write back before returning. */
+
 #endif /* lib/syscall-nr.h */
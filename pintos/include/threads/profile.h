@@ -0,0 +1,25 @@
+#ifndef THREADS_PROFILE_H
+#define THREADS_PROFILE_H
+
+#include <stdbool.h>
+
+#include "threads/interrupt.h"
+
+/* Sampling profiler.
+ *
+ * When enabled with the -prof kernel option, every timer interrupt
+ * records the interrupted rip and up to PROFILE_DEPTH_MAX - 1
+ * return addresses found by walking the frame-pointer chain.
+ * profile_dump() prints the samples at power off in a form that
+ * `backtrace --profile' turns into a flat profile and folded
+ * stacks. */
+#define PROFILE_DEPTH_MAX 16
+
+extern bool profile_enabled;
+extern int profile_depth;
+
+void profile_init(void);
+void profile_sample(const struct intr_frame*);
+void profile_dump(void);
+
+#endif /* threads/profile.h */
@@ -38,6 +38,20 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Spinlock.
+ *
+ * Busy-waits instead of sleeping, so it may be used where a
+ * thread cannot block, such as the scheduler itself.  Interrupts
+ * must be off while a spinlock is held; otherwise a handler on
+ * the same CPU could spin on it forever. */
+struct spinlock {
+	volatile int locked;        /* Nonzero while held. */
+};
+
+void spin_lock_init (struct spinlock *);
+void spin_lock (struct spinlock *);
+void spin_unlock (struct spinlock *);
+
 /* Optimization barrier.
  *
  * The compiler will not reorder operations across an
@@ -8,6 +8,7 @@
 #include "synch.h"
 #include "threads/fixed-point.h"
 #include "threads/interrupt.h"
+#include "threads/timer-wheel.h"
 #ifdef VM
 #include "vm/vm.h"
 #endif
@@ -30,6 +31,14 @@ typedef int tid_t;
 #define PRI_DEFAULT 31 /* Default priority. */
 #define PRI_MAX 63     /* Highest priority. */
 
+/* The run queue keeps one bit per priority level in a 64-bit word. */
+#if PRI_MAX - PRI_MIN >= 64
+#error run queue bitmap needs PRI_MAX - PRI_MIN < 64
+#endif
+
+/* Maximum number of CPUs that per-CPU state is kept for. */
+#define NCPU_MAX 8
+
 /* A kernel thread or user process.
  *
  * Each thread structure is stored in its own 4 kB page.  The
@@ -102,10 +111,12 @@ struct thread {
     /* Shared between thread.c and synch.c. */
     struct list_elem elem; /* List element. */
     struct list_elem allelem;
-    int64_t wakeup_tick;
+    struct timer sleep_timer; /* Wakeup timer while in thread_sleep(). */
 
     int nice;
     fixed_t recent_cpu;
+    int64_t recent_cpu_epoch;   /* Second recent_cpu was last decayed. */
+    struct list_elem mlfqs_elem; /* Element in MLFQS blocked list. */
 
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
@@ -142,6 +153,8 @@ struct child_info {
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+unsigned cpu_id(void);
+
 void thread_init(void);
 void thread_start(void);
 
@@ -166,6 +179,8 @@ void wake_sleeping_threads(int64_t tick);
 
 int thread_get_priority(void);
 void thread_set_priority(int);
+void thread_update_priority(struct thread*, int);
+void thread_mlfqs_refresh(struct thread*);
 int thread_get_nice(void);
 void thread_set_nice(int);
 int thread_get_recent_cpu(void);
@@ -0,0 +1,38 @@
+#ifndef THREADS_TIMER_WHEEL_H
+#define THREADS_TIMER_WHEEL_H
+
+#include <list.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Hierarchical timing wheel.
+ *
+ * Level L has TW_SLOTS slots, each covering TW_SLOTS^L ticks, so
+ * the wheel as a whole covers TW_SLOTS^TW_LEVELS ticks ahead of
+ * the current time.  Timers further out wait on an overflow list
+ * until the top level wraps.  Adding and cancelling a timer are
+ * O(1); advancing by one tick is amortized O(1) plus the number of
+ * timers that expire. */
+#define TW_LEVEL_BITS 6
+#define TW_SLOTS (1 << TW_LEVEL_BITS)
+#define TW_LEVELS 4
+
+/* A timer.  Embed it in the object that should be woken up. */
+struct timer {
+    struct list_elem elem; /* Element in a wheel slot. */
+    int64_t expires;       /* Absolute tick to fire at. */
+};
+
+struct timer_wheel {
+    int64_t now;                             /* Last tick processed. */
+    struct list slots[TW_LEVELS][TW_SLOTS]; /* Pending timers. */
+    struct list overflow;                    /* Timers beyond the top level. */
+    size_t cnt;                              /* Number of pending timers. */
+};
+
+void timer_wheel_init(struct timer_wheel*, int64_t now);
+void timer_wheel_add(struct timer_wheel*, struct timer*);
+void timer_wheel_cancel(struct timer_wheel*, struct timer*);
+void timer_wheel_advance(struct timer_wheel*, int64_t now, struct list* expired);
+
+#endif /* threads/timer-wheel.h */
@@ -1,14 +1,22 @@
 #ifndef VM_ANON_H
 #define VM_ANON_H
 #include "vm/vm.h"
+#include <stddef.h>
 struct page;
 enum vm_type;
 
+/* Swap slot value of a page that is not in swap. */
+#define SWAP_SLOT_NONE ((size_t) -1)
+
 struct anon_page {
+	size_t swap_slot;		/* Swap slot holding the page, if evicted. */
+	bool compressed;		/* SWAP_SLOT is a zswap handle instead. */
 };
 
 void vm_anon_init (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
 bool anon_copy(struct supplemental_page_table *dst, struct page *src_page);
+size_t anon_disk_slot (struct page *page);
+void anon_discard (struct page *page);
 
 #endif
@@ -4,10 +4,18 @@
 #include "vm/vm.h"
 
 struct page;
+struct vma;
 enum vm_type;
 
+/* Identifies a page of a file, for the file page index. */
+struct file_key {
+	struct inode *inode;
+	off_t pos;				/* Page-aligned offset in the file. */
+	size_t read_bytes;		/* Bytes of the page taken from the file. */
+};
+
 struct file_page {
-	struct file *mapped_file;
+	struct file *mapped_file;	/* Owned by the page's area. */
 	void *mmap_base;
 	size_t read_bytes;
 	size_t zero_bytes;
@@ -19,4 +27,10 @@ bool file_backed_initializer (struct page *page, enum vm_type type, void *kva);
 void *do_mmap(void *addr, size_t length, int writable,
 		struct file *file, off_t offset);
 void do_munmap (void *va);
+bool file_copy (struct supplemental_page_table *dst, struct page *src_page);
+bool file_page_key (struct page *page, struct file_key *key);
+void file_page_adopt (struct page *page);
+void file_writeback_area (struct vma *vma, void *start, void *end);
+void file_writeback_pages (struct page **pages, size_t cnt);
+void file_print_stats (void);
 #endif
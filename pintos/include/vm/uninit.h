@@ -54,6 +54,9 @@ struct uninit_page {
 	bool (*page_initializer) (struct page *, enum vm_type, void *kva);
 };
 
+void vm_uninit_init (void);
+struct uninit_aux *uninit_aux_alloc (void);
+void uninit_aux_free (struct uninit_aux *aux);
 void uninit_new (struct page *page, void *va, vm_initializer *init,
 		enum vm_type type, void *aux,
 		bool (*initializer)(struct page *, enum vm_type, void *kva));
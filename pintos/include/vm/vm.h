@@ -3,6 +3,7 @@
 #include <stdbool.h>
 #include "threads/palloc.h"
 #include <hash.h>
+#include <list.h>
 
 enum vm_type {
 	/* page not initialized */
@@ -29,6 +30,7 @@ enum vm_type {
 #include "vm/uninit.h"
 #include "vm/anon.h"
 #include "vm/file.h"
+#include "vm/vma.h"
 #ifdef EFILESYS
 #include "filesys/page_cache.h"
 #endif
@@ -39,6 +41,37 @@ struct thread;
 #define VM_TYPE(type) ((type) & 7)
 #define USER_STACK_MAX_SIZE (1 << 20)
 
+/* Pages loaded per fault on a lazily loaded executable segment,
+ * counting the faulting page.  1 disables fault-around.  Memory
+ * mappings are faulted around only if vm_fault_around_mmap, which
+ * setting the window with -fa turns on. */
+#define VM_FAULT_AROUND_DEFAULT 4
+#define VM_FAULT_AROUND_MAX 16
+extern int vm_fault_around;
+extern bool vm_fault_around_mmap;
+
+/* Pages read per fault on an anonymous page in swap, counting the
+ * faulting page, as long as they sit in consecutive swap slots.
+ * 1 disables swap readahead. */
+#define VM_SWAP_READAHEAD_DEFAULT 8
+extern int vm_swap_readahead;
+
+/* Free user frames below which the reclaim daemon wakes, and
+ * that it reclaims up to before sleeping again.  A low watermark
+ * of 0 disables the daemon. */
+#define VM_WMARK_LOW_DEFAULT 16
+#define VM_WMARK_HIGH_DEFAULT 32
+extern size_t vm_wmark_low;
+extern size_t vm_wmark_high;
+
+/* Milliseconds a mapped file page may stay dirty before the
+ * flusher writes it back, and between the flusher's passes.  An
+ * age of 0 disables the flusher. */
+#define VM_FLUSH_AGE_DEFAULT 3000
+#define VM_FLUSH_PERIOD_DEFAULT 1000
+extern int vm_flush_age;
+extern int vm_flush_period;
+
 /* The representation of "page".
  * This is kind of "parent class", which has four "child class"es, which are
  * uninit_page, file_page, anon_page, and page cache (project4).
@@ -51,6 +84,11 @@ struct page {
 	/* Your implementation */
 	struct hash_elem hs_elem;
 	bool writable;			/* 쓰기 가능 여부 나타내는 필드(다른 비트와 결합해서 쓸 예정)*/
+	struct thread *owner;	/* Thread whose pml4 maps this page. */
+	struct list_elem frame_elem;	/* Element in frame's page list. */
+	bool prefetched;		/* Loaded by fault-around, not yet used. */
+	struct vma *vma;		/* Area the page belongs to, if any. */
+	struct list_elem vma_elem;	/* Element in the area's page list. */
 
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -67,9 +105,33 @@ struct page {
 /* The representation of "frame" */
 struct frame {
 	void *kva;
-	struct page *page;
+	struct list pages;		/* Pages mapping this frame. */
+	int ref_cnt;			/* Number of pages in PAGES. */
+	struct list_elem elem;	/* Element in the frame table. */
+	int pin_cnt;			/* Not to be evicted while nonzero. */
+	bool evicting;			/* Being written out by an evictor. */
+	bool flushing;			/* Being written back by the flusher. */
+
+	/* A frame holding a page of a memory-mapped file is entered in
+	 * the file page index, so that every mapping of that page, in
+	 * any process, shares it. */
+	struct inode *inode;	/* File of the page, or NULL if unindexed. */
+	off_t pos;				/* Offset of the page in the file. */
+	bool dirty;				/* Written through a mapping that has
+							 * since gone; see vm_frame_take_dirty(). */
+	struct hash_elem index_elem;	/* Element in the file page index. */
+	int64_t flush_at;		/* Tick at which the flusher writes it
+							 * back if still dirty, or 0. */
 };
 
+/* Returns the first page mapping FRAME.  A frame may be mapped by
+ * several pages: an anonymous frame shared after fork is mapped
+ * read-only by all of them until one writes, and a file page frame
+ * is mapped by every mapping of that page, writable where the
+ * mapping is once it has written; see vm_handle_wp(). */
+#define frame_page(frame) \
+	list_entry (list_front (&(frame)->pages), struct page, frame_elem)
+
 /* The function table for page operations.
  * This is one way of implementing "interface" in C.
  * Put the table of "method" into the struct's member, and
@@ -92,6 +154,9 @@ struct page_operations {
 struct supplemental_page_table {
 	/* 해시 테이블 */
 	struct hash hs_table;
+	struct list vmas;		/* Areas, sorted by address. */
+	size_t swap_next;		/* Swap slot to try for the next page
+							 * evicted to disk, or SWAP_SLOT_NONE. */
 };
 
 #include "threads/thread.h"
@@ -105,6 +170,8 @@ bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
 
 void vm_init (void);
+void vm_print_stats (void);
+bool vm_madvise (void *addr, size_t length, int advice);
 bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 		bool write, bool not_present);
 
@@ -114,6 +181,14 @@ bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 		bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page (struct page *page);
 bool vm_claim_page (void *va);
+bool vm_pin_page (struct page *page);
+bool vm_pin_page_if_resident (struct page *page);
+void vm_unpin_page (struct page *page);
+void vm_free_frame (struct page *page);
+bool vm_share_frame (struct page *dst, struct page *src);
+bool vm_frame_take_dirty (struct page *page);
+bool vm_frame_clean (struct page *page);
+bool vm_msync (void *addr, size_t length, int flags);
 enum vm_type page_get_type (struct page *page);
 
 #endif  /* VM_VM_H */
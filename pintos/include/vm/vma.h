@@ -0,0 +1,46 @@
+#ifndef VM_VMA_H
+#define VM_VMA_H
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "vm/uninit.h"
+
+struct page;
+struct file;
+struct supplemental_page_table;
+enum vm_type;
+
+/* A virtual memory area: a page-aligned range of user addresses
+ * backed by one file, such as a memory mapping or an executable
+ * segment.  The struct page for an address in the range is only
+ * created when the address is first faulted on. */
+struct vma {
+	void *start;			/* First address, page-aligned. */
+	void *end;				/* One past the last page. */
+	enum vm_type type;		/* VM_FILE for mmap, VM_ANON for segments. */
+	bool writable;
+	struct file *file;		/* The area's own handle on the file. */
+	off_t offset;			/* File offset of START. */
+	size_t read_bytes;		/* Bytes from START read from FILE;
+							   the rest of the area is zeroed. */
+	vm_initializer *init;	/* Loads each page on its first fault. */
+	int advice;				/* MADV_* set by madvise(). */
+	struct list pages;		/* Pages created in the area so far. */
+	struct list_elem elem;	/* Element in the spt's list of areas. */
+};
+
+struct vma *vma_create (struct supplemental_page_table *spt, void *start,
+		size_t length, enum vm_type type, bool writable, struct file *file,
+		off_t offset, size_t read_bytes, vm_initializer *init);
+struct vma *vma_find (struct supplemental_page_table *spt, void *va);
+size_t vma_page_read_bytes (struct vma *vma, void *va);
+struct page *vma_page_create (struct vma *vma, void *va);
+void vma_add_page (struct vma *vma, struct page *page);
+void vma_remove_page (struct page *page);
+void vma_unmap (struct supplemental_page_table *spt, struct vma *vma);
+bool vma_copy_all (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src);
+void vma_destroy_all (struct supplemental_page_table *spt);
+
+#endif /* vm/vma.h */
@@ -0,0 +1,19 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Compressed swap pool size in pages, set by the -zswap kernel
+ * option.  0 disables the pool. */
+#define ZSWAP_DEFAULT_PAGES 64
+extern size_t zswap_pages;
+
+void zswap_init (void);
+bool zswap_store (const void *kva, unsigned refs, size_t *handle);
+void zswap_load (size_t handle, void *kva);
+void zswap_ref (size_t handle);
+void zswap_unref (size_t handle);
+void zswap_note_disk_load (void);
+void zswap_print_stats (void);
+
+#endif /* vm/zswap.h */
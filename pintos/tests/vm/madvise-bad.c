@@ -0,0 +1,22 @@
+/* Passes madvise() a misaligned address, an unknown advice
+   value, an unmapped range and a kernel address, all of which
+   must fail without terminating the process. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[4096] __attribute__ ((aligned (4096)));
+
+void
+test_main (void)
+{
+  CHECK (madvise (buf + 1, 4096, MADV_WILLNEED) == -1,
+         "try to madvise misaligned address");
+  CHECK (madvise (buf, 4096, 99) == -1, "try to madvise unknown advice");
+  CHECK (madvise ((void *) 0x10000000, 4096, MADV_WILLNEED) == -1,
+         "try to madvise unmapped range");
+  CHECK (madvise ((void *) 0x8004000000, 4096, MADV_DONTNEED) == -1,
+         "try to madvise kernel address");
+  CHECK (madvise (buf, 4096, MADV_NORMAL) == 0, "madvise mapped page");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(madvise-bad) begin
+(madvise-bad) try to madvise misaligned address
+(madvise-bad) try to madvise unknown advice
+(madvise-bad) try to madvise unmapped range
+(madvise-bad) try to madvise kernel address
+(madvise-bad) madvise mapped page
+(madvise-bad) end
+madvise-bad: exit(0)
+EOF
+pass;
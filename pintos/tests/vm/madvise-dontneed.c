@@ -0,0 +1,34 @@
+/* Writes anonymous pages, drops them with MADV_DONTNEED, and
+   checks that they are unloaded and read back as zeros. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 3
+
+static char buf[PAGE_CNT * PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+
+void
+test_main (void)
+{
+  size_t i;
+  int result;
+  bool unloaded = true;
+
+  memset (buf, 'x', sizeof buf);
+  result = madvise (buf, sizeof buf, MADV_DONTNEED);
+  for (i = 0; i < PAGE_CNT; i++)
+    if (get_phys_addr (buf + i * PAGE_SIZE) != 0)
+      unloaded = false;
+  CHECK (result == 0, "madvise dontneed");
+  CHECK (unloaded, "check if pages are not loaded");
+
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu is %02hhx after MADV_DONTNEED (should be 0)",
+            i, buf[i]);
+  msg ("pages read back as zeros");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise-dontneed) begin
+(madvise-dontneed) madvise dontneed
+(madvise-dontneed) check if pages are not loaded
+(madvise-dontneed) pages read back as zeros
+(madvise-dontneed) end
+EOF
+pass;
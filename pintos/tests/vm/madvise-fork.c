@@ -0,0 +1,46 @@
+/* Drops a written stack page, which belongs to no mapping, with
+   MADV_DONTNEED and forks without touching it again.  The page
+   has neither a frame nor a swap slot at fork, and must read back
+   as zeros in both the child and the parent. */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+
+/* Returns true if the page at PAGE is all zeros. */
+static bool
+is_zero (const char *page)
+{
+  size_t i;
+
+  for (i = 0; i < PAGE_SIZE; i++)
+    if (page[i] != 0)
+      return false;
+  return true;
+}
+
+void
+test_main (void)
+{
+  char stack_buf[2 * PAGE_SIZE];
+  char *page = (char *) (((uintptr_t) stack_buf + PAGE_SIZE - 1)
+                         & ~(uintptr_t) (PAGE_SIZE - 1));
+  pid_t child;
+
+  memset (page, 'x', PAGE_SIZE);
+  CHECK (madvise (page, PAGE_SIZE, MADV_DONTNEED) == 0, "madvise dontneed");
+
+  child = fork ("child");
+  if (child == 0)
+    {
+      if (!is_zero (page))
+        fail ("dropped page is not zero in child");
+      exit (0);
+    }
+  CHECK (wait (child) == 0, "wait for child");
+  CHECK (is_zero (page), "dropped page reads back as zeros");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise-fork) begin
+(madvise-fork) madvise dontneed
+(madvise-fork) wait for child
+(madvise-fork) dropped page reads back as zeros
+(madvise-fork) end
+EOF
+pass;
@@ -0,0 +1,36 @@
+/* Checks that MADV_RANDOM turns off the readahead that an
+   earlier MADV_SEQUENTIAL turned on. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/small.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  int handle;
+  void *map;
+
+  CHECK ((handle = open ("small.txt")) > 1, "open \"small.txt\"");
+  CHECK ((map = mmap (actual, sizeof small, 0, handle, 0)) != MAP_FAILED,
+         "mmap \"small.txt\"");
+  CHECK (madvise (map, sizeof small, MADV_SEQUENTIAL) == 0,
+         "madvise sequential");
+  CHECK (madvise (map, sizeof small, MADV_RANDOM) == 0, "madvise random");
+
+  if (actual[0] != small[0])
+    fail ("read of mmap'd file reported bad data");
+  CHECK (get_phys_addr (actual + PAGE_SIZE) == 0,
+         "check if next page is not loaded");
+
+  if (memcmp (actual, small, sizeof small))
+    fail ("read of mmap'd file reported bad data");
+
+  munmap (map);
+  close (handle);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise-random) begin
+(madvise-random) open "small.txt"
+(madvise-random) mmap "small.txt"
+(madvise-random) madvise sequential
+(madvise-random) madvise random
+(madvise-random) check if next page is not loaded
+(madvise-random) end
+EOF
+pass;
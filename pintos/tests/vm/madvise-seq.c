@@ -0,0 +1,40 @@
+/* Maps a file with MADV_SEQUENTIAL and checks that the first
+   fault also reads the following pages ahead, so a sequential
+   scan of the mapping takes a single fault. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/small.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  size_t page_cnt = (sizeof small + PAGE_SIZE - 1) / PAGE_SIZE;
+  int handle;
+  void *map;
+  size_t i;
+
+  CHECK ((handle = open ("small.txt")) > 1, "open \"small.txt\"");
+  CHECK ((map = mmap (actual, sizeof small, 0, handle, 0)) != MAP_FAILED,
+         "mmap \"small.txt\"");
+  CHECK (madvise (map, sizeof small, MADV_SEQUENTIAL) == 0,
+         "madvise sequential");
+
+  if (actual[0] != small[0])
+    fail ("read of mmap'd file reported bad data");
+  for (i = 1; i < page_cnt; i++)
+    if (get_phys_addr (actual + i * PAGE_SIZE) == 0)
+      fail ("page %zu was not read ahead", i);
+  msg ("pages read ahead");
+
+  if (memcmp (actual, small, sizeof small))
+    fail ("read of mmap'd file reported bad data");
+
+  munmap (map);
+  close (handle);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise-seq) begin
+(madvise-seq) open "small.txt"
+(madvise-seq) mmap "small.txt"
+(madvise-seq) madvise sequential
+(madvise-seq) pages read ahead
+(madvise-seq) end
+EOF
+pass;
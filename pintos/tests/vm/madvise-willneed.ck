@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise-willneed) begin
+(madvise-willneed) open "small.txt"
+(madvise-willneed) mmap "small.txt"
+(madvise-willneed) madvise willneed
+(madvise-willneed) pages loaded
+(madvise-willneed) end
+EOF
+pass;
@@ -0,0 +1,42 @@
+/* Maps a file in a process and again, separately, in its child.
+   Both mappings must use the same frame, so the child's write
+   shows up in the parent's mapping without any write-back. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PARENT ((char *) 0x10000000)
+#define CHILD ((char *) 0x20000000)
+
+void
+test_main (void)
+{
+  int handle;
+  pid_t child;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mmap (PARENT, 4096, 1, handle, 0) != MAP_FAILED,
+         "mmap \"sample.txt\"");
+  if (memcmp (PARENT, sample, strlen (sample)))
+    fail ("read of mmap'd file reported bad data");
+
+  child = fork ("child");
+  if (child == 0)
+    {
+      if (mmap (CHILD, 4096, 1, handle, 0) == MAP_FAILED)
+        fail ("mmap in child failed");
+      if (memcmp (CHILD, sample, strlen (sample)))
+        fail ("read of mmap'd file in child reported bad data");
+      if (get_phys_addr (CHILD) != get_phys_addr (PARENT))
+        fail ("mappings of the same file page use different frames");
+      memcpy (CHILD, "shared", 6);
+      exit (0);
+    }
+  wait (child);
+
+  CHECK (!memcmp (PARENT, "shared", 6), "check child's write is visible");
+  close (handle);
+}
@@ -0,0 +1,33 @@
+/* Passes msync() a misaligned address, conflicting and unknown
+   flags, a range that is not a memory mapping and a kernel
+   address, all of which must fail without terminating the
+   process. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((char *) 0x10000000)
+
+static char buf[4096] __attribute__ ((aligned (4096)));
+
+void
+test_main (void)
+{
+  int handle;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mmap (ACTUAL, 4096, 0, handle, 0) != MAP_FAILED,
+         "mmap \"sample.txt\"");
+  CHECK (msync (ACTUAL + 1, 4096, MS_SYNC) == -1,
+         "try to msync misaligned address");
+  CHECK (msync (ACTUAL, 4096, MS_SYNC | MS_ASYNC) == -1,
+         "try to msync with MS_SYNC and MS_ASYNC");
+  CHECK (msync (ACTUAL, 4096, 64) == -1, "try to msync unknown flag");
+  CHECK (msync (buf, 4096, MS_SYNC) == -1, "try to msync anonymous memory");
+  CHECK (msync (ACTUAL, 8192, MS_SYNC) == -1,
+         "try to msync past the mapping");
+  CHECK (msync ((void *) 0x8004000000, 4096, MS_SYNC) == -1,
+         "try to msync kernel address");
+  CHECK (msync (ACTUAL, 4096, MS_ASYNC) == 0, "msync mapped page");
+}
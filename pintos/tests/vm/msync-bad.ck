@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(msync-bad) begin
+(msync-bad) open "sample.txt"
+(msync-bad) mmap "sample.txt"
+(msync-bad) try to msync misaligned address
+(msync-bad) try to msync with MS_SYNC and MS_ASYNC
+(msync-bad) try to msync unknown flag
+(msync-bad) try to msync anonymous memory
+(msync-bad) try to msync past the mapping
+(msync-bad) try to msync kernel address
+(msync-bad) msync mapped page
+(msync-bad) end
+msync-bad: exit(0)
+EOF
+pass;
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(msync-sync) begin
+(msync-sync) create "sample.txt"
+(msync-sync) open "sample.txt"
+(msync-sync) mmap "sample.txt"
+(msync-sync) msync "sample.txt"
+(msync-sync) compare read data against written data
+(msync-sync) end
+msync-sync: exit(0)
+EOF
+pass;
@@ -19,7 +19,9 @@
 #include "threads/malloc.h"
 #include "threads/mmu.h"
 #include "threads/palloc.h"
+#include "threads/profile.h"
 #include "threads/pte.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -32,11 +34,17 @@
 #include "tests/threads/tests.h"
 #ifdef VM
 #include "vm/vm.h"
+#include "vm/zswap.h"
 #endif
 #ifdef FILESYS
 #include "devices/disk.h"
+#include "filesys/directory.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
+#ifdef EFILESYS
+#include "filesys/fat.h"
+#endif
+#include "filesys/page_cache.h"
 #endif
 
 /* Page-map-level-4 with kernel mappings only. */
@@ -86,7 +94,9 @@ main (void) {
 	/* Initialize memory system. */
 	mem_end = palloc_init ();
 	malloc_init ();
+	kmem_init ();
 	paging_init (mem_end);
+	profile_init ();
 
 #ifdef USERPROG
 	tss_init ();
@@ -219,18 +229,66 @@ parse_options (char **argv) {
 		else if (!strcmp (name, "-q"))
 			power_off_when_done = true;
 #ifdef FILESYS
-		else if (!strcmp (name, "-f"))
+		else if (!strcmp (name, "-f")) {
 			format_filesys = true;
+#ifdef EFILESYS
+			if (value != NULL) {
+				fat_format_cluster_sectors = atoi (value);
+				if (fat_format_cluster_sectors < 1
+						|| fat_format_cluster_sectors > MAX_SECTORS_PER_CLUSTER
+						|| (fat_format_cluster_sectors
+							& (fat_format_cluster_sectors - 1)) != 0)
+					PANIC ("-f=SECTORS must be a power of 2 up to %d",
+							MAX_SECTORS_PER_CLUSTER);
+			}
+#endif
+		}
 #endif
 		else if (!strcmp (name, "-rs"))
 			random_init (atoi (value));
 		else if (!strcmp (name, "-mlfqs"))
 			thread_mlfqs = true;
+		else if (!strcmp (name, "-prof")) {
+			profile_enabled = true;
+			if (value != NULL)
+				profile_depth = atoi (value);
+		}
 #ifdef USERPROG
 		else if (!strcmp (name, "-ul"))
 			user_page_limit = atoi (value);
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;
+#endif
+#ifdef VM
+		else if (!strcmp (name, "-fa")) {
+			vm_fault_around = atoi (value);
+			vm_fault_around_mmap = true;
+			if (vm_fault_around < 1 || vm_fault_around > VM_FAULT_AROUND_MAX)
+				PANIC ("-fa=PAGES must be between 1 and %d", VM_FAULT_AROUND_MAX);
+		}
+		else if (!strcmp (name, "-sra")) {
+			vm_swap_readahead = atoi (value);
+			if (vm_swap_readahead < 1 || vm_swap_readahead > VM_FAULT_AROUND_MAX)
+				PANIC ("-sra=PAGES must be between 1 and %d", VM_FAULT_AROUND_MAX);
+		}
+		else if (!strcmp (name, "-zswap"))
+			zswap_pages = atoi (value);
+		else if (!strcmp (name, "-wm")) {
+			char *high = strchr (value, ',');
+			vm_wmark_low = atoi (value);
+			vm_wmark_high = high != NULL ? (size_t) atoi (high + 1)
+				: 2 * vm_wmark_low;
+			if (vm_wmark_low > 0 && vm_wmark_high <= vm_wmark_low)
+				PANIC ("-wm=LOW,HIGH needs HIGH above LOW");
+		}
+		else if (!strcmp (name, "-flush")) {
+			char *period = strchr (value, ',');
+			vm_flush_age = atoi (value);
+			if (period != NULL)
+				vm_flush_period = atoi (period + 1);
+			if (vm_flush_age < 0 || vm_flush_period < 1)
+				PANIC ("-flush=AGE[,PERIOD] needs a positive PERIOD");
+		}
 #endif
 		else
 			PANIC ("unknown option `%s' (use -h for help)", name);
@@ -329,10 +387,30 @@ usage (void) {
 			"  -h                 Print this help message and power off.\n"
 			"  -q                 Power off VM after actions or on panic.\n"
 			"  -f                 Format file system disk during startup.\n"
+#ifdef EFILESYS
+			"  -f=SECTORS         ...with SECTORS sectors per cluster (default 1).\n"
+#endif
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
+			"  -prof[=DEPTH]      Sample the kernel on each timer tick, recording\n"
+			"                     up to DEPTH frames, and dump at power off.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+			"  -fa=PAGES          Load up to PAGES pages per file-backed fault\n"
+			"                     (default 4 for executables only, mmaps\n"
+			"                     included once set; 1 disables).\n"
+			"  -sra=PAGES         Read up to PAGES consecutive pages per swap-in\n"
+			"                     (default 8, 1 disables swap readahead).\n"
+			"  -zswap=PAGES       Keep up to PAGES pages of compressed swap\n"
+			"                     in memory (default 64, 0 disables).\n"
+			"  -wm=LOW[,HIGH]     Wake the reclaim daemon below LOW free user\n"
+			"                     frames, reclaim up to HIGH (default 16,32;\n"
+			"                     0 disables it, HIGH defaults to 2*LOW).\n"
+			"  -flush=AGE[,PERIOD] Write back mapped file pages dirty for AGE ms,\n"
+			"                     checking every PERIOD ms (default 3000,1000;\n"
+			"                     0 disables the flusher).\n"
 #endif
 			);
 	power_off ();
@@ -348,6 +426,7 @@ power_off (void) {
 #endif
 
 	print_stats ();
+	profile_dump ();
 
 	printf ("Powering off...\n");
 	outw (0x604, 0x2000);               /* Poweroff command for qemu */
@@ -361,10 +440,18 @@ print_stats (void) {
 	thread_print_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
+	page_cache_print_stats ();
+	dir_print_stats ();
 #endif
 	console_print_stats ();
 	kbd_print_stats ();
 #ifdef USERPROG
 	exception_print_stats ();
 #endif
+#ifdef VM
+	vm_print_stats ();
+#endif
+	palloc_print_stats ();
+	malloc_print_stats ();
+	kmem_print_stats ();
 }
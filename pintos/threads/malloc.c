@@ -5,8 +5,10 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* A simple implementation of malloc().
@@ -32,7 +34,16 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   In front of each descriptor's free list, every CPU keeps a
+   small "magazine" of free blocks.  malloc() and free() only
+   disable interrupts to pop or push the current CPU's magazine,
+   without taking the descriptor's lock.  An empty magazine is
+   refilled, and a full one drained, by MAG_BATCH blocks at a
+   time under the lock.  Blocks in magazines count as in use, so
+   an arena is given back only once none of its blocks sits in a
+   magazine. */
 
 /* Descriptor. */
 struct desc {
@@ -61,8 +72,31 @@ struct block {
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Blocks a magazine holds, and moves to or from a free list at
+   once. */
+#define MAG_SIZE 16
+#define MAG_BATCH (MAG_SIZE / 2)
+
+/* Magazine: a CPU's free blocks of one descriptor. */
+struct magazine {
+	size_t cnt;                 /* Number of blocks. */
+	struct block *blocks[MAG_SIZE];
+};
+
+/* Per-CPU magazines and statistics.  Only touched by their CPU,
+   with interrupts off. */
+struct malloc_cpu {
+	struct magazine mags[sizeof descs / sizeof *descs];
+	unsigned long long alloc_cnt;   /* Small blocks allocated. */
+	unsigned long long free_cnt;    /* Small blocks freed. */
+	unsigned long long lock_cnt;    /* Descriptor lock acquisitions. */
+};
+static struct malloc_cpu malloc_cpus[NCPU_MAX];
+
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static void *refill (struct desc *);
+static void drain (struct desc *, struct block *);
 
 /* Initializes the malloc() descriptors. */
 void
@@ -112,35 +146,155 @@ malloc (size_t size) {
 		return a + 1;
 	}
 
-	lock_acquire (&d->lock);
+	/* Take a block from this CPU's magazine if it has one. */
+	enum intr_level old_level = intr_disable ();
+	struct malloc_cpu *mc = &malloc_cpus[cpu_id ()];
+	struct magazine *m = &mc->mags[d - descs];
+	mc->alloc_cnt++;
+	if (m->cnt > 0) {
+		b = m->blocks[--m->cnt];
+		intr_set_level (old_level);
+		return b;
+	}
+	intr_set_level (old_level);
+	return refill (d);
+}
 
-	/* If the free list is empty, create a new arena. */
-	if (list_empty (&d->free_list)) {
-		size_t i;
+/* Takes up to CNT blocks from D's free list into BLOCKS, creating
+   arenas as needed, and returns how many it took. */
+static size_t
+desc_take (struct desc *d, struct block **blocks, size_t cnt) {
+	size_t n;
 
-		/* Allocate a page. */
-		a = palloc_get_page (0);
-		if (a == NULL) {
-			lock_release (&d->lock);
-			return NULL;
+	lock_acquire (&d->lock);
+	for (n = 0; n < cnt; n++) {
+		struct block *b;
+		struct arena *a;
+
+		/* If the free list is empty, create a new arena. */
+		if (list_empty (&d->free_list)) {
+			size_t i;
+
+			/* Allocate a page. */
+			a = palloc_get_page (0);
+			if (a == NULL)
+				break;
+
+			/* Initialize arena and add its blocks to the free list. */
+			a->magic = ARENA_MAGIC;
+			a->desc = d;
+			a->free_cnt = d->blocks_per_arena;
+			for (i = 0; i < d->blocks_per_arena; i++) {
+				struct block *b = arena_to_block (a, i);
+				list_push_back (&d->free_list, &b->free_elem);
+			}
 		}
 
-		/* Initialize arena and add its blocks to the free list. */
-		a->magic = ARENA_MAGIC;
-		a->desc = d;
-		a->free_cnt = d->blocks_per_arena;
-		for (i = 0; i < d->blocks_per_arena; i++) {
-			struct block *b = arena_to_block (a, i);
-			list_push_back (&d->free_list, &b->free_elem);
-		}
+		/* Get a block from free list. */
+		b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
+		a = block_to_arena (b);
+		a->free_cnt--;
+		blocks[n] = b;
 	}
+	lock_release (&d->lock);
+	return n;
+}
+
+/* Returns the CNT blocks in BLOCKS to D's free list, giving back
+   arenas that become entirely unused. */
+static void
+desc_put (struct desc *d, struct block **blocks, size_t cnt) {
+	size_t n;
+
+	lock_acquire (&d->lock);
+	for (n = 0; n < cnt; n++) {
+		struct block *b = blocks[n];
+		struct arena *a = block_to_arena (b);
+
+		/* Add block to free list. */
+		list_push_front (&d->free_list, &b->free_elem);
+
+		/* If the arena is now entirely unused, free it. */
+		if (++a->free_cnt >= d->blocks_per_arena) {
+			size_t i;
 
-	/* Get a block from free list and return it. */
-	b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-	a = block_to_arena (b);
-	a->free_cnt--;
+			ASSERT (a->free_cnt == d->blocks_per_arena);
+			for (i = 0; i < d->blocks_per_arena; i++) {
+				struct block *b = arena_to_block (a, i);
+				list_remove (&b->free_elem);
+			}
+			palloc_free_page (a);
+		}
+	}
 	lock_release (&d->lock);
-	return b;
+}
+
+/* Slow path of malloc() for D: refills the current CPU's
+   magazine from the free list and returns one of its blocks, or
+   a null pointer if memory is not available. */
+static void *
+refill (struct desc *d) {
+	struct block *batch[MAG_BATCH];
+	size_t n = desc_take (d, batch, MAG_BATCH);
+	enum intr_level old_level;
+	struct malloc_cpu *mc;
+	struct magazine *m;
+
+	if (n == 0)
+		return NULL;
+
+	/* We may have slept on the lock; the magazine is the current
+	   CPU's, and may have been refilled meanwhile. */
+	old_level = intr_disable ();
+	mc = &malloc_cpus[cpu_id ()];
+	mc->lock_cnt++;
+	m = &mc->mags[d - descs];
+	while (n > 1 && m->cnt < MAG_SIZE)
+		m->blocks[m->cnt++] = batch[--n];
+	intr_set_level (old_level);
+
+	if (n > 1)
+		desc_put (d, batch + 1, n - 1);
+	return batch[0];
+}
+
+/* Slow path of free() for D: B did not fit in the current CPU's
+   full magazine, so returns it and half of the magazine to the
+   free list. */
+static void
+drain (struct desc *d, struct block *b) {
+	struct block *batch[MAG_BATCH + 1];
+	enum intr_level old_level;
+	struct malloc_cpu *mc;
+	struct magazine *m;
+	size_t n = 0;
+
+	old_level = intr_disable ();
+	mc = &malloc_cpus[cpu_id ()];
+	mc->lock_cnt++;
+	m = &mc->mags[d - descs];
+	while (n < MAG_BATCH && m->cnt > 0)
+		batch[n++] = m->blocks[--m->cnt];
+	intr_set_level (old_level);
+
+	batch[n++] = b;
+	desc_put (d, batch, n);
+}
+
+/* Prints malloc() statistics: how many small-block allocations
+   and frees needed a descriptor lock. */
+void
+malloc_print_stats (void) {
+	unsigned long long allocs = 0, frees = 0, locks = 0;
+	unsigned i;
+
+	for (i = 0; i < NCPU_MAX; i++) {
+		allocs += malloc_cpus[i].alloc_cnt;
+		frees += malloc_cpus[i].free_cnt;
+		locks += malloc_cpus[i].lock_cnt;
+	}
+	printf ("Malloc: %llu allocs, %llu frees, %llu lock acquisitions\n",
+			allocs, frees, locks);
 }
 
 /* Allocates and return A times B bytes initialized to zeroes.
@@ -213,24 +367,18 @@ free (void *p) {
 			memset (b, 0xcc, d->block_size);
 #endif
 
-			lock_acquire (&d->lock);
-
-			/* Add block to free list. */
-			list_push_front (&d->free_list, &b->free_elem);
-
-			/* If the arena is now entirely unused, free it. */
-			if (++a->free_cnt >= d->blocks_per_arena) {
-				size_t i;
-
-				ASSERT (a->free_cnt == d->blocks_per_arena);
-				for (i = 0; i < d->blocks_per_arena; i++) {
-					struct block *b = arena_to_block (a, i);
-					list_remove (&b->free_elem);
-				}
-				palloc_free_page (a);
+			/* Put it in this CPU's magazine if there is room. */
+			enum intr_level old_level = intr_disable ();
+			struct malloc_cpu *mc = &malloc_cpus[cpu_id ()];
+			struct magazine *m = &mc->mags[d - descs];
+			mc->free_cnt++;
+			if (m->cnt < MAG_SIZE) {
+				m->blocks[m->cnt++] = b;
+				intr_set_level (old_level);
+				return;
 			}
-
-			lock_release (&d->lock);
+			intr_set_level (old_level);
+			drain (d, b);
 		} else {
 			/* It's a big block.  Free its pages. */
 			palloc_free_multiple (a, a->free_cnt);
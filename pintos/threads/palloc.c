@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -24,13 +25,35 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is a binary buddy allocator.  Its free pages form
+   blocks of 2**ORDER pages, aligned to their size relative to
+   the pool base, kept on one free list per order.  A request for
+   PAGE_CNT pages takes the smallest free block that is large
+   enough, splitting larger ones as needed, and gives the pages
+   past PAGE_CNT back.  A freed block merges with its buddy, the
+   other half of the block twice its size, whenever that is free
+   too.  Both take O(log n) steps.  The per-page order and list
+   elements live next to the bitmap, not in the free pages, which
+   are not yet mapped when the pools are built. */
+
+/* Largest block order; blocks are at most 2**MAX_ORDER pages. */
+#define MAX_ORDER 20
+
+/* order_map value of a page that does not start a free block. */
+#define NO_ORDER 0xff
 
 /* A memory pool. */
 struct pool {
-	struct lock lock;               /* Mutual exclusion. */
+	struct spinlock lock;           /* Mutual exclusion. */
 	struct bitmap *used_map;        /* Bitmap of free pages. */
 	uint8_t *base;                  /* Base of pool. */
+	uint8_t *order_map;             /* Order of the free block starting
+	                                   at each page, or NO_ORDER. */
+	struct list_elem *block_elems;  /* Free list element of each page. */
+	struct list free_lists[MAX_ORDER + 1];  /* Free blocks by order. */
+	size_t free_cnt[MAX_ORDER + 1];         /* Length of each list. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -42,6 +65,10 @@ static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static size_t pool_free_cnt (const struct pool *);
+static size_t buddy_alloc (struct pool *, size_t page_cnt);
+static void buddy_free_range (struct pool *, size_t page_idx,
+		size_t page_cnt);
 
 /* multiboot info */
 struct multiboot_info {
@@ -224,11 +251,13 @@ split:
 			if ((uint64_t) pool_end < end) {
 				page_cnt = ((uint64_t) pool_end - start) / PGSIZE;
 				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				buddy_free_range (pool, page_idx, page_cnt);
 				start = (uint64_t) pool_end;
 				goto split;
 			} else {
 				page_cnt = ((uint64_t) end - start) / PGSIZE;
 				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				buddy_free_range (pool, page_idx, page_cnt);
 			}
 		}
 	}
@@ -262,12 +291,23 @@ palloc_init (void) {
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-
-	lock_acquire (&pool->lock);
-	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-	lock_release (&pool->lock);
+	enum intr_level old_level;
+	size_t page_idx;
 	void *pages;
 
+	/* Pages are also freed with interrupts off, by the scheduler,
+	   so the pool is guarded by a spinlock with interrupts off
+	   rather than by a lock. */
+	old_level = intr_disable ();
+	spin_lock (&pool->lock);
+	page_idx = buddy_alloc (pool, page_cnt);
+	if (page_idx != BITMAP_ERROR) {
+		ASSERT (bitmap_none (pool->used_map, page_idx, page_cnt));
+		bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+	}
+	spin_unlock (&pool->lock);
+	intr_set_level (old_level);
+
 	if (page_idx != BITMAP_ERROR)
 		pages = pool->base + PGSIZE * page_idx;
 	else
@@ -301,6 +341,7 @@ void
 palloc_free_multiple (void *pages, size_t page_cnt) {
 	struct pool *pool;
 	size_t page_idx;
+	enum intr_level old_level;
 
 	ASSERT (pg_ofs (pages) == 0);
 	if (pages == NULL || page_cnt == 0)
@@ -318,8 +359,13 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 #ifndef NDEBUG
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
+	old_level = intr_disable ();
+	spin_lock (&pool->lock);
 	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
 	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	buddy_free_range (pool, page_idx, page_cnt);
+	spin_unlock (&pool->lock);
+	intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -328,21 +374,48 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
+/* Returns the number of free pages in the user pool if PAL_USER
+   is set in FLAGS, otherwise in the kernel pool. */
+size_t
+palloc_free_cnt (enum palloc_flags flags) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	enum intr_level old_level;
+	size_t cnt;
+
+	old_level = intr_disable ();
+	spin_lock (&pool->lock);
+	cnt = pool_free_cnt (pool);
+	spin_unlock (&pool->lock);
+	intr_set_level (old_level);
+	return cnt;
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
+  /* We'll put the pool's used_map and order_map at its base.
+     Calculate the space needed for them
      and subtract it from the pool's size. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
-	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
-
-	lock_init(&p->lock);
-	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
+	size_t bm_size = ROUND_UP (bitmap_buf_size (pgcnt), sizeof (void *));
+	size_t elems_size = pgcnt * sizeof (struct list_elem);
+	size_t bm_pages = DIV_ROUND_UP (bm_size + elems_size + pgcnt, PGSIZE)
+		* PGSIZE;
+	int order;
+
+	spin_lock_init(&p->lock);
+	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_size);
 	p->base = (void *) start;
+	p->block_elems = (struct list_elem *) ((uint8_t *) *bm_base + bm_size);
+	p->order_map = (uint8_t *) p->block_elems + elems_size;
+	for (order = 0; order <= MAX_ORDER; order++) {
+		list_init (&p->free_lists[order]);
+		p->free_cnt[order] = 0;
+	}
 
 	// Mark all to unusable.
 	bitmap_set_all(p->used_map, true);
+	memset (p->order_map, NO_ORDER, pgcnt);
 
 	*bm_base += bm_pages;
 }
@@ -356,3 +429,121 @@ page_from_pool (const struct pool *pool, void *page) {
 	size_t end_page = start_page + bitmap_size (pool->used_map);
 	return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns the list element of the free block at PAGE_IDX in P. */
+static struct list_elem *
+block_elem (struct pool *p, size_t page_idx) {
+	return &p->block_elems[page_idx];
+}
+
+/* Adds the free block of 2**ORDER pages at PAGE_IDX to P. */
+static void
+buddy_insert (struct pool *p, size_t page_idx, int order) {
+	p->order_map[page_idx] = order;
+	list_push_front (&p->free_lists[order], block_elem (p, page_idx));
+	p->free_cnt[order]++;
+}
+
+/* Takes the free block of 2**ORDER pages at PAGE_IDX out of P. */
+static void
+buddy_remove (struct pool *p, size_t page_idx, int order) {
+	ASSERT (p->order_map[page_idx] == order);
+	p->order_map[page_idx] = NO_ORDER;
+	list_remove (block_elem (p, page_idx));
+	p->free_cnt[order]--;
+}
+
+/* Frees the block of 2**ORDER pages at PAGE_IDX in P, merging it
+   with its buddy for as long as the buddy is free. */
+static void
+buddy_free (struct pool *p, size_t page_idx, int order) {
+	size_t pgcnt = bitmap_size (p->used_map);
+
+	for (; order < MAX_ORDER; order++) {
+		size_t buddy = page_idx ^ ((size_t) 1 << order);
+		if (buddy + ((size_t) 1 << order) > pgcnt
+				|| p->order_map[buddy] != order)
+			break;
+		buddy_remove (p, buddy, order);
+		page_idx &= ~((size_t) 1 << order);
+	}
+	buddy_insert (p, page_idx, order);
+}
+
+/* Frees the PAGE_CNT pages at PAGE_IDX in P, as the fewest
+   blocks that are aligned to their size. */
+static void
+buddy_free_range (struct pool *p, size_t page_idx, size_t page_cnt) {
+	while (page_cnt > 0) {
+		int order = 0;
+
+		while (order < MAX_ORDER
+				&& (page_idx & ((size_t) 1 << order)) == 0
+				&& ((size_t) 2 << order) <= page_cnt)
+			order++;
+		buddy_free (p, page_idx, order);
+		page_idx += (size_t) 1 << order;
+		page_cnt -= (size_t) 1 << order;
+	}
+}
+
+/* Allocates PAGE_CNT contiguous pages from P and returns the
+   index of the first, or BITMAP_ERROR if no free block is large
+   enough. */
+static size_t
+buddy_alloc (struct pool *p, size_t page_cnt) {
+	int order = 0, k;
+	size_t page_idx;
+
+	while (((size_t) 1 << order) < page_cnt)
+		if (++order > MAX_ORDER)
+			return BITMAP_ERROR;
+	for (k = order; k <= MAX_ORDER && list_empty (&p->free_lists[k]); k++)
+		continue;
+	if (k > MAX_ORDER)
+		return BITMAP_ERROR;
+
+	page_idx = list_front (&p->free_lists[k]) - p->block_elems;
+	buddy_remove (p, page_idx, k);
+
+	/* Give back the pages past PAGE_CNT. */
+	buddy_free_range (p, page_idx + page_cnt,
+			((size_t) 1 << k) - page_cnt);
+	return page_idx;
+}
+
+/* Returns the number of free pages in P. */
+static size_t
+pool_free_cnt (const struct pool *p) {
+	size_t free_pages = 0;
+	int order;
+
+	for (order = 0; order <= MAX_ORDER; order++)
+		free_pages += p->free_cnt[order] << order;
+	return free_pages;
+}
+
+/* Prints P's free pages by block order, to show how fragmented
+   it is. */
+static void
+print_pool_stats (const char *name, struct pool *p) {
+	int order, top = -1;
+
+	for (order = 0; order <= MAX_ORDER; order++)
+		if (p->free_cnt[order] > 0)
+			top = order;
+	printf ("%s pool: %zu of %zu pages free, largest block %zu pages\n",
+			name, pool_free_cnt (p), bitmap_size (p->used_map),
+			top >= 0 ? (size_t) 1 << top : 0);
+	printf ("%s pool free blocks by order:", name);
+	for (order = 0; order <= top; order++)
+		printf (" %zu", p->free_cnt[order]);
+	printf ("\n");
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void) {
+	print_pool_stats ("Kernel", &kernel_pool);
+	print_pool_stats ("User", &user_pool);
+}
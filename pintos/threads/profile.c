@@ -0,0 +1,103 @@
+#include "threads/profile.h"
+
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Number of pages backing the sample buffer. */
+#define PROFILE_PAGES 64
+
+/* Set by the -prof kernel option. */
+bool profile_enabled;
+
+/* Entries recorded per sample, including the rip itself.
+   Set by -prof=DEPTH; 1 records only the rip. */
+int profile_depth = 8;
+
+/* Sample buffer: SAMPLE_CAP samples of PROFILE_DEPTH entries
+   each.  An entry of 0 ends a short stack.  A sample taken in
+   user mode holds the single entry PROFILE_USER. */
+#define PROFILE_USER ((uintptr_t)1)
+static uintptr_t* samples;
+static size_t sample_cap;
+static size_t sample_cnt;
+static long long dropped_cnt;
+
+/* Allocates the sample buffer.  Must be called after the page
+   allocator is initialized.  Does nothing unless -prof was
+   given. */
+void profile_init(void) {
+    if (!profile_enabled) return;
+
+    if (profile_depth < 1) profile_depth = 1;
+    if (profile_depth > PROFILE_DEPTH_MAX) profile_depth = PROFILE_DEPTH_MAX;
+
+    samples = palloc_get_multiple(PAL_ZERO, PROFILE_PAGES);
+    if (samples == NULL) {
+        printf("profile: cannot allocate sample buffer, profiling disabled\n");
+        profile_enabled = false;
+        return;
+    }
+    sample_cap = PROFILE_PAGES * PGSIZE / (profile_depth * sizeof *samples);
+}
+
+/* Records one sample of the code interrupted by F.  Called from
+   the timer interrupt handler.  Once the buffer is full further
+   samples are only counted. */
+void profile_sample(const struct intr_frame* f) {
+    uintptr_t* s;
+    void** frame;
+    int i;
+
+    if (!profile_enabled) return;
+    if (sample_cnt >= sample_cap) {
+        dropped_cnt++;
+        return;
+    }
+
+    s = samples + sample_cnt++ * profile_depth;
+    if ((f->cs & 3) != 0) {
+        s[0] = PROFILE_USER;
+        return;
+    }
+
+    /* Walk saved rbp links, but only within the interrupted
+       thread's kernel stack page so a bogus rbp cannot fault. */
+    s[0] = f->rip;
+    frame = (void**)f->R.rbp;
+    for (i = 1; i < profile_depth; i++) {
+        if ((uintptr_t)frame < f->rsp || pg_round_down(frame + 1) != pg_round_down(f->rsp))
+            break;
+        s[i] = (uintptr_t)frame[1];
+        frame = frame[0];
+    }
+}
+
+/* Prints the recorded samples, one per line, innermost frame
+   first.  Run `backtrace --profile' on the output to symbolize
+   it. */
+void profile_dump(void) {
+    size_t n;
+    int i;
+
+    if (!profile_enabled) return;
+    profile_enabled = false; /* Stop sampling while we print. */
+
+    printf("Profile: %zu samples, %lld dropped, depth %d\n", sample_cnt, dropped_cnt,
+           profile_depth);
+    for (n = 0; n < sample_cnt; n++) {
+        const uintptr_t* s = samples + n * profile_depth;
+
+        if (s[0] == PROFILE_USER) {
+            printf("PROF user\n");
+            continue;
+        }
+        printf("PROF");
+        for (i = 0; i < profile_depth && s[i] != 0; i++) printf(" %#llx", s[i]);
+        printf("\n");
+    }
+    printf("Profile end\n");
+}
@@ -0,0 +1,240 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Object caches.
+
+   Each cache hands out objects of one size, carved out of
+   page-sized "slabs".  A slab starts with a header followed by
+   as many objects as fit; its free objects are chained through
+   their first word, or through a word just past the object in
+   caches with a constructor, so that free objects stay
+   constructed.  A cache keeps its slabs on three lists by
+   how many of their objects are in use, and allocates from a
+   partially used slab first so that objects pack into as few
+   pages as possible.
+
+   Unlike malloc(), no size-class search or arena lookup is
+   needed, each cache has its own lock, and an optional
+   constructor runs once per object when its slab is created
+   rather than on every allocation.
+
+   One completely free slab is kept per cache to absorb
+   alloc/free cycles on a boundary; further free slabs go back to
+   the page allocator. */
+
+/* Cache. */
+struct kmem_cache {
+	const char *name;           /* For statistics. */
+	size_t obj_size;            /* Size of each object in bytes. */
+	size_t link_ofs;            /* Offset of the free-list link. */
+	size_t stride;              /* Distance between objects. */
+	size_t objs_per_slab;       /* Number of objects in a slab. */
+	kmem_ctor *ctor;            /* Constructor, or null. */
+	struct lock lock;           /* Protects everything below. */
+	struct list full;           /* Slabs with no free object. */
+	struct list partial;        /* Slabs with some free objects. */
+	struct list empty;          /* Slabs with no object in use. */
+	size_t slab_cnt;            /* Slabs on all three lists. */
+	size_t in_use;              /* Objects handed out. */
+	unsigned long long allocs;  /* kmem_cache_alloc() calls. */
+	unsigned long long grows;   /* ...that had to create a slab. */
+	struct list_elem elem;      /* Element in all_caches. */
+};
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Slab header, at the start of its page. */
+struct slab {
+	unsigned magic;             /* Always set to SLAB_MAGIC. */
+	struct kmem_cache *cache;   /* Owning cache. */
+	size_t in_use;              /* Objects handed out. */
+	void *free;                 /* First free object. */
+	struct list_elem elem;      /* Element in one of the cache's lists. */
+};
+
+/* Every cache, for kmem_print_stats(). */
+static struct list all_caches;
+
+static struct slab *slab_create (struct kmem_cache *);
+static struct slab *obj_to_slab (struct kmem_cache *, void *obj);
+static void **obj_link (struct kmem_cache *, void *obj);
+
+/* Initializes the cache list. */
+void
+kmem_init (void) {
+	list_init (&all_caches);
+}
+
+/* Creates and returns a cache of SIZE-byte objects named NAME,
+   whose objects are initialized by CTOR, if non-null, when their
+   slab is created.  Panics if SIZE does not fit in a slab or
+   memory is not available; caches are created at boot. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, kmem_ctor *ctor) {
+	struct kmem_cache *c;
+
+	size = ROUND_UP (size < sizeof (void *) ? sizeof (void *) : size,
+			sizeof (void *));
+	ASSERT (sizeof (struct slab) + size + sizeof (void *) <= PGSIZE);
+
+	c = malloc (sizeof *c);
+	if (c == NULL)
+		PANIC ("kmem_cache_create: out of memory for cache %s", name);
+	c->name = name;
+	c->obj_size = size;
+	c->link_ofs = ctor != NULL ? size : 0;
+	c->stride = ctor != NULL ? size + sizeof (void *) : size;
+	c->objs_per_slab = (PGSIZE - sizeof (struct slab)) / c->stride;
+	c->ctor = ctor;
+	lock_init (&c->lock);
+	list_init (&c->full);
+	list_init (&c->partial);
+	list_init (&c->empty);
+	c->slab_cnt = 0;
+	c->in_use = 0;
+	c->allocs = 0;
+	c->grows = 0;
+	list_push_back (&all_caches, &c->elem);
+	return c;
+}
+
+/* Obtains and returns an object from cache C.
+   Returns a null pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c) {
+	struct slab *s;
+	void *obj;
+
+	lock_acquire (&c->lock);
+	c->allocs++;
+	if (!list_empty (&c->partial))
+		s = list_entry (list_front (&c->partial), struct slab, elem);
+	else if (!list_empty (&c->empty)) {
+		s = list_entry (list_pop_front (&c->empty), struct slab, elem);
+		list_push_front (&c->partial, &s->elem);
+	} else {
+		s = slab_create (c);
+		if (s == NULL) {
+			lock_release (&c->lock);
+			return NULL;
+		}
+		c->grows++;
+		list_push_front (&c->partial, &s->elem);
+	}
+
+	obj = s->free;
+	s->free = *obj_link (c, obj);
+	if (++s->in_use == c->objs_per_slab) {
+		list_remove (&s->elem);
+		list_push_back (&c->full, &s->elem);
+	}
+	c->in_use++;
+	lock_release (&c->lock);
+	return obj;
+}
+
+/* Returns OBJ, which must have been allocated from C, to C.
+   A null OBJ is ignored. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj) {
+	struct slab *s;
+
+	if (obj == NULL)
+		return;
+	s = obj_to_slab (c, obj);
+
+#ifndef NDEBUG
+	/* Clear the object to help detect use-after-free bugs. */
+	if (c->ctor == NULL)
+		memset (obj, 0xcc, c->obj_size);
+#endif
+
+	lock_acquire (&c->lock);
+	*obj_link (c, obj) = s->free;
+	s->free = obj;
+	c->in_use--;
+	if (s->in_use-- == c->objs_per_slab) {
+		list_remove (&s->elem);
+		list_push_front (&c->partial, &s->elem);
+	}
+	if (s->in_use == 0) {
+		list_remove (&s->elem);
+		if (list_empty (&c->empty))
+			list_push_back (&c->empty, &s->elem);
+		else {
+			c->slab_cnt--;
+			palloc_free_page (s);
+		}
+	}
+	lock_release (&c->lock);
+}
+
+/* Prints statistics for every cache. */
+void
+kmem_print_stats (void) {
+	struct list_elem *e;
+
+	for (e = list_begin (&all_caches); e != list_end (&all_caches);
+			e = list_next (e)) {
+		struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+		unsigned long long hits = c->allocs - c->grows;
+
+		printf ("Slab %s: %zu in use, %zu slabs, %llu allocs, %llu%% hit\n",
+				c->name, c->in_use, c->slab_cnt, c->allocs,
+				c->allocs ? hits * 100 / c->allocs : 100);
+	}
+}
+
+/* Allocates a slab for cache C and constructs its objects.
+   C's lock must be held. */
+static struct slab *
+slab_create (struct kmem_cache *c) {
+	struct slab *s = palloc_get_page (0);
+	uint8_t *obj;
+	size_t i;
+
+	if (s == NULL)
+		return NULL;
+	s->magic = SLAB_MAGIC;
+	s->cache = c;
+	s->in_use = 0;
+	s->free = NULL;
+
+	/* Chain the objects so that the lowest is handed out first. */
+	obj = (uint8_t *) (s + 1) + (c->objs_per_slab - 1) * c->stride;
+	for (i = 0; i < c->objs_per_slab; i++, obj -= c->stride) {
+		if (c->ctor != NULL)
+			c->ctor (obj);
+		*obj_link (c, obj) = s->free;
+		s->free = obj;
+	}
+	c->slab_cnt++;
+	return s;
+}
+
+/* Returns the slab that OBJ, from cache C, is inside. */
+static struct slab *
+obj_to_slab (struct kmem_cache *c, void *obj) {
+	struct slab *s = pg_round_down (obj);
+
+	ASSERT (s->magic == SLAB_MAGIC);
+	ASSERT (s->cache == c);
+	ASSERT (((uint8_t *) obj - (uint8_t *) (s + 1)) % c->stride == 0);
+	return s;
+}
+
+/* Returns the free-list link of OBJ, from cache C. */
+static void **
+obj_link (struct kmem_cache *c, void *obj) {
+	return (void **) ((uint8_t *) obj + c->link_ofs);
+}
@@ -114,6 +114,14 @@ void sema_up(struct semaphore* sema) {
     old_level = intr_disable();
     sema->value++;
     if (!list_empty(&sema->waiters)) {
+        struct list_elem* e;
+
+        /* Under MLFQS, waiters' priorities are only brought up to
+           date when examined. */
+        if (thread_mlfqs)
+            for (e = list_begin(&sema->waiters); e != list_end(&sema->waiters); e = list_next(e))
+                thread_mlfqs_refresh(list_entry(e, struct thread, elem));
+
         struct list_elem* max_elem = list_max(&sema->waiters, thread_priority_max, NULL);
         list_remove(max_elem);
         thread_unblock(list_entry(max_elem, struct thread, elem));
@@ -196,7 +204,7 @@ void lock_acquire(struct lock* lock) {
 
         int depth = 0;
         while (cur && depth < MAX_DEPTH) {
-            cur->priority = t->priority;
+            thread_update_priority(cur, t->priority);
             if (!cur->waiting_lock) break;
             cur = cur->waiting_lock->holder;
             depth++;
@@ -265,6 +273,32 @@ bool lock_held_by_current_thread(const struct lock* lock) {
     return lock->holder == thread_current();
 }
 
+/* Initializes spinlock LOCK as released. */
+void spin_lock_init(struct spinlock* lock) {
+    ASSERT(lock != NULL);
+
+    lock->locked = 0;
+}
+
+/* Acquires LOCK, spinning until it is released by whichever CPU
+   holds it.  Interrupts must be off, and stay off until the
+   matching spin_unlock(). */
+void spin_lock(struct spinlock* lock) {
+    ASSERT(lock != NULL);
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    while (__atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE))
+        while (lock->locked) asm volatile("pause" : : : "memory");
+}
+
+/* Releases LOCK, which the caller must hold. */
+void spin_unlock(struct spinlock* lock) {
+    ASSERT(lock != NULL);
+    ASSERT(lock->locked);
+
+    __atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+}
+
 /* One semaphore in a list. */
 struct semaphore_elem {
     struct list_elem elem;      /* List element. */
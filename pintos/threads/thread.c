@@ -29,14 +29,46 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
-static struct list sleep_list;
+/* Run queue of processes in THREAD_READY state, that is, processes
+   that are ready to run but not actually running.  There is one
+   FIFO per priority level and a bitmap of the non-empty levels, so
+   enqueue, dequeue and finding the highest ready priority are all
+   constant time. */
+struct ready_queue {
+    struct list levels[PRI_MAX + 1]; /* One FIFO per priority. */
+    uint64_t bitmap;                 /* Bit P set iff levels[P] is non-empty. */
+    size_t cnt;                      /* Number of threads in all levels. */
+};
+
+/* MLFQS recomputes priorities every MLFQS_PRI_PERIOD ticks. */
+#define MLFQS_PRI_PERIOD 4
+
+/* Scheduler state of a CPU.  Only the bootstrap processor is
+   brought up, so there is one, and interrupts being off is all
+   that protects it. */
+struct cpu {
+    struct ready_queue ready_queue; /* Threads ready to run here. */
+    struct thread* idle_thread;     /* Runs when nothing else is ready. */
+    struct thread* curr;            /* Thread currently running here. */
+    unsigned thread_ticks;          /* # of timer ticks since last yield. */
+
+    /* Threads charged a tick since the last MLFQS priority
+       recomputation; their priorities may be stale. */
+    struct thread* mlfqs_charged[MLFQS_PRI_PERIOD];
+    int mlfqs_charged_cnt;
+
+    /* Statistics. */
+    long long idle_ticks;   /* # of timer ticks spent idle. */
+    long long kernel_ticks; /* # of timer ticks in kernel threads. */
+    long long user_ticks;   /* # of timer ticks in user programs. */
+};
+
+/* The bootstrap processor, the only CPU the kernel runs on. */
+static struct cpu bsp;
+
+/* Sleeping threads, keyed by wakeup tick. */
+static struct timer_wheel sleep_wheel;
 static struct list all_list;
-/* Idle thread. */
-static struct thread* idle_thread;
-
 /* Initial thread, the thread running init.c:main(). */
 static struct thread* initial_thread;
 
@@ -46,14 +78,8 @@ static struct lock tid_lock;
 /* Thread destruction requests */
 static struct list destruction_req;
 
-/* Statistics. */
-static long long idle_ticks;   /* # of timer ticks spent idle. */
-static long long kernel_ticks; /* # of timer ticks in kernel threads. */
-static long long user_ticks;   /* # of timer ticks in user programs. */
-
 /* Scheduling. */
-#define TIME_SLICE 4          /* # of timer ticks to give each thread. */
-static unsigned thread_ticks; /* # of timer ticks since last yield. */
+#define TIME_SLICE 4 /* # of timer ticks to give each thread. */
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
@@ -69,15 +95,37 @@ static void do_schedule(int status);
 static void schedule(void);
 static tid_t allocate_tid(void);
 
-static bool sleep_list_order(const struct list_elem* e1, const struct list_elem* e2, void* aux);
+static void cpu_init(struct cpu* c);
+static void ready_queue_init(struct ready_queue* rq);
+static void ready_queue_push(struct ready_queue* rq, struct thread* t);
+static void ready_queue_remove(struct ready_queue* rq, struct thread* t);
+static struct thread* ready_queue_pop(struct ready_queue* rq);
+static int ready_queue_max_priority(const struct ready_queue* rq);
+static void thread_make_ready(struct thread* t);
+static void cpu_enqueue(struct thread* t);
 
 static fixed_t load_avg;
 
+/* MLFQS decays every thread's recent_cpu once per second.  Only
+   running and ready threads are decayed on time; a blocked thread
+   records the second it was last brought up to date in
+   recent_cpu_epoch and replays the decays it missed from
+   decay_log when it is next examined.  Blocked threads sit on
+   mlfqs_blocked_list oldest epoch first, so the few about to fall
+   out of the log can be caught up before their coefficients are
+   overwritten. */
+#define MLFQS_DECAY_LOG 64
+static fixed_t decay_log[MLFQS_DECAY_LOG]; /* Coefficient of each second. */
+static int64_t mlfqs_seconds;               /* Seconds elapsed. */
+static struct list mlfqs_blocked_list;      /* Blocked threads. */
+
+static int mlfqs_calc_priority(const struct thread* t);
 static void mlfqs_update_priority(struct thread* t);
-static void mlfqs_update_recent_cpu(struct thread* t);
+static void mlfqs_catch_up(struct thread* t);
 static void mlfqs_update_load_avg(void);
-static void mlfqs_update_recent_cpu_all(void);
-static void mlfqs_update_priority_all(void);
+static void mlfqs_second(void);
+static void mlfqs_charge(struct cpu* c, struct thread* t);
+static void mlfqs_update_charged(struct cpu* c);
 
 /* Returns true if T appears to point to a valid thread. */
 #define is_thread(t) ((t) != NULL && (t)->magic == THREAD_MAGIC)
@@ -89,6 +137,12 @@ static void mlfqs_update_priority_all(void);
  * somewhere in the middle, this locates the curent thread. */
 #define running_thread() ((struct thread*)(pg_round_down(rrsp())))
 
+/* Returns the scheduler state of the executing CPU. */
+#define this_cpu() (&bsp)
+
+/* Returns true if T is the idle thread. */
+#define is_idle_thread(t) ((t) == bsp.idle_thread)
+
 // Global descriptor table for the thread_start.
 // Because the gdt will be setup after the thread_init, we should
 // setup temporal gdt first.
@@ -118,22 +172,29 @@ void thread_init(void) {
 
     /* Init the globla thread context */
     lock_init(&tid_lock);
-    list_init(&ready_list);
+    cpu_init(&bsp);
     list_init(&destruction_req);
     list_init(&all_list);
 
     load_avg = FP_CONST(0);
+    mlfqs_seconds = 0;
+    list_init(&mlfqs_blocked_list);
     /* Set up a thread structure for the running thread. */
     initial_thread = running_thread();
     init_thread(initial_thread, "main", PRI_DEFAULT);
     initial_thread->status = THREAD_RUNNING;
+    bsp.curr = initial_thread;
     initial_thread->tid = allocate_tid();
 
-    list_init(&sleep_list);
+    timer_wheel_init(&sleep_wheel, 0);
 }
 
+/* Returns the index of the CPU executing the caller, which is
+   always the bootstrap processor's, 0. */
+unsigned cpu_id(void) { return 0; }
+
 /* Starts preemptive thread scheduling by enabling interrupts.
-   Also creates the idle thread. */
+   Also creates the bootstrap processor's idle thread. */
 void thread_start(void) {
     /* Create the idle thread. */
     struct semaphore idle_started;
@@ -151,34 +212,34 @@ void thread_start(void) {
    Thus, this function runs in an external interrupt context. */
 void thread_tick(void) {
     struct thread* t = thread_current();
+    struct cpu* c = this_cpu();
 
     /* Update statistics. */
-    if (t == idle_thread) idle_ticks++;
+    if (t == c->idle_thread) c->idle_ticks++;
 #ifdef USERPROG
     else if (t->pml4 != NULL)
-        user_ticks++;
+        c->user_ticks++;
 #endif
     else
-        kernel_ticks++;
+        c->kernel_ticks++;
 
     if (thread_mlfqs) {
-        if (t != idle_thread) t->recent_cpu = FP_ADD_MIXED(t->recent_cpu, 1);
-
-        if (timer_ticks() % TIMER_FREQ == 0) {
-            mlfqs_update_load_avg();
-            mlfqs_update_recent_cpu_all();
+        if (t != c->idle_thread) {
+            t->recent_cpu = FP_ADD_MIXED(t->recent_cpu, 1);
+            mlfqs_charge(c, t);
         }
 
-        if (timer_ticks() % 4 == 0) mlfqs_update_priority_all();
+        if (timer_ticks() % TIMER_FREQ == 0) mlfqs_second();
+        if (timer_ticks() % MLFQS_PRI_PERIOD == 0) mlfqs_update_charged(c);
     }
     /* Enforce preemption. */
-    if (++thread_ticks >= TIME_SLICE) intr_yield_on_return();
+    if (++c->thread_ticks >= TIME_SLICE) intr_yield_on_return();
 }
 
 /* Prints thread statistics. */
 void thread_print_stats(void) {
-    printf("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n", idle_ticks,
-           kernel_ticks, user_ticks);
+    printf("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n", bsp.idle_ticks,
+           bsp.kernel_ticks, bsp.user_ticks);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -214,7 +275,13 @@ tid_t thread_create(const char* name, int priority, thread_func* function, void*
     if (thread_mlfqs) {
         t->nice = parent_t->nice;
         t->recent_cpu = parent_t->recent_cpu;
-        mlfqs_update_priority(t);
+        t->recent_cpu_epoch = mlfqs_seconds;
+        t->priority = mlfqs_calc_priority(t);
+
+        /* Still blocked until thread_unblock() below. */
+        enum intr_level old_level = intr_disable();
+        list_push_back(&mlfqs_blocked_list, &t->mlfqs_elem);
+        intr_set_level(old_level);
     }
 
     /* Call the kernel_thread if it scheduled.
@@ -252,9 +319,13 @@ tid_t thread_create(const char* name, int priority, thread_func* function, void*
    is usually a better idea to use one of the synchronization
    primitives in synch.h. */
 void thread_block(void) {
+    struct thread* cur = thread_current();
+
     ASSERT(!intr_context());
     ASSERT(intr_get_level() == INTR_OFF);
-    thread_current()->status = THREAD_BLOCKED;
+    if (thread_mlfqs && !is_idle_thread(cur))
+        list_push_back(&mlfqs_blocked_list, &cur->mlfqs_elem);
+    cur->status = THREAD_BLOCKED;
     schedule();
 }
 
@@ -272,9 +343,7 @@ void thread_unblock(struct thread* t) {
     ASSERT(is_thread(t));
 
     old_level = intr_disable();
-    ASSERT(t->status == THREAD_BLOCKED);
-    t->status = THREAD_READY;
-    list_push_front(&ready_list, &t->elem);
+    thread_make_ready(t);
     intr_set_level(old_level);
     if (t->priority > thread_current()->priority) {
         if (intr_context())
@@ -320,6 +389,13 @@ void thread_exit(void) {
        We will be destroyed during the call to schedule_tail(). */
     intr_disable();
     list_remove(&thread_current()->allelem);
+    if (thread_mlfqs) {
+        int i;
+
+        /* Our page is about to be freed. */
+        for (i = 0; i < bsp.mlfqs_charged_cnt; i++)
+            if (bsp.mlfqs_charged[i] == thread_current()) bsp.mlfqs_charged[i] = NULL;
+    }
     do_schedule(THREAD_DYING);
     NOT_REACHED();
 }
@@ -333,14 +409,15 @@ void thread_yield(void) {
     ASSERT(!intr_context());
 
     old_level = intr_disable();
-    if (curr != idle_thread) list_push_front(&ready_list, &curr->elem);
+    if (curr != this_cpu()->idle_thread) cpu_enqueue(curr);
     do_schedule(THREAD_READY);
     intr_set_level(old_level);
 }
 
 /// @brief
 /// 현재 스레드를 지정된 시간까지 재운다.
-/// 스레드는 sleep_list에 추가되고, wakeup_tick이 도달할 때까지 BLOCKED 상태로 전환된다.
+/// 스레드는 sleep_wheel에 추가되고, wakeup_tick이 도달할 때까지 BLOCKED 상태로 전환된다.
+/// (타이밍 휠에 넣으므로 잠든 스레드 수와 관계없이 O(1))
 ///
 /// @param wakeup_tick
 /// 스레드가 다시 깨어날 시점의 절대 tick 값 (`timer_ticks() + ticks`)
@@ -348,23 +425,36 @@ void thread_sleep(int64_t wakeup_tick) {
     enum intr_level old_level = intr_disable();
 
     struct thread* cur_thread = thread_current();
-    cur_thread->wakeup_tick = wakeup_tick;
-    list_insert_ordered(&sleep_list, &cur_thread->elem, sleep_list_order, NULL);
+    cur_thread->sleep_timer.expires = wakeup_tick;
+    timer_wheel_add(&sleep_wheel, &cur_thread->sleep_timer);
     thread_block();
 
     intr_set_level(old_level);
 }
 
 /// @brief
-/// 현재 시각(ticks)에 도달한 스레드들을 깨워 READY 상태로 전환한다.
-/// (sleep_list의 맨 앞부터 검사하며, wakeup_tick이 아직 안 된 스레드는 남겨둔다.)
+/// 현재 시각(ticks)에 도달한 스레드들을 한꺼번에 READY 상태로 전환한다.
+/// 깨운 스레드마다 선점 여부를 따지지 않고, 모두 run queue에 넣은 뒤
+/// 더 높은 우선순위의 스레드가 있으면 인터럽트 복귀 시 한 번만 양보한다.
 void wake_sleeping_threads(int64_t tick) {
     enum intr_level old_level = intr_disable();
-    while (!list_empty(&sleep_list)) {
-        struct thread* cur_thread = list_entry(list_front(&sleep_list), struct thread, elem);
-        if (cur_thread->wakeup_tick > tick) break;
-        list_pop_front(&sleep_list);
-        thread_unblock(cur_thread);
+    struct list expired;
+    bool preempt = false;
+
+    list_init(&expired);
+    timer_wheel_advance(&sleep_wheel, tick, &expired);
+    while (!list_empty(&expired)) {
+        struct thread* t =
+            list_entry(list_pop_front(&expired), struct thread, sleep_timer.elem);
+        thread_make_ready(t);
+        if (t->priority > thread_current()->priority) preempt = true;
+    }
+
+    if (preempt) {
+        if (intr_context())
+            intr_yield_on_return();
+        else
+            thread_yield();
     }
     intr_set_level(old_level);
 }
@@ -378,17 +468,35 @@ void thread_set_priority(int new_priority) {
     t->base_priority = new_priority;
     if (list_empty(&thread_current()->donor_list)) t->priority = new_priority;
 
-    if (!list_empty(&ready_list) &&
-        (new_priority <
-         list_entry(list_max(&ready_list, thread_priority_max, NULL), struct thread, elem)
-             ->priority))
-        thread_yield();
+    if (new_priority < ready_queue_max_priority(&this_cpu()->ready_queue)) thread_yield();
     intr_set_level(old_level);
 }
 
 /* Returns the current thread's priority. */
 int thread_get_priority(void) { return thread_current()->priority; }
 
+/* Changes T's effective priority to PRIORITY, moving T to the
+   matching run queue level if it is ready.  Used by priority
+   donation and by the MLFQS recomputation, which may change the
+   priority of threads other than the running one. */
+void thread_update_priority(struct thread* t, int priority) {
+    enum intr_level old_level;
+
+    ASSERT(is_thread(t));
+    ASSERT(PRI_MIN <= priority && priority <= PRI_MAX);
+
+    old_level = intr_disable();
+    if (t->priority != priority) {
+        if (t->status == THREAD_READY) {
+            ready_queue_remove(&bsp.ready_queue, t);
+            t->priority = priority;
+            ready_queue_push(&bsp.ready_queue, t);
+        } else
+            t->priority = priority;
+    }
+    intr_set_level(old_level);
+}
+
 /* Sets the current thread's nice value to NICE. */
 void thread_set_nice(int nice) {
     ASSERT(nice >= -20 && nice <= 20);
@@ -397,11 +505,8 @@ void thread_set_nice(int nice) {
     thread_current()->nice = nice;
     mlfqs_update_priority(thread_current());
 
-    if (!list_empty(&ready_list)) {
-        struct thread* max_ready =
-            list_entry(list_max(&ready_list, thread_priority_max, NULL), struct thread, elem);
-        if (thread_current()->priority < max_ready->priority) thread_yield();
-    }
+    if (thread_current()->priority < ready_queue_max_priority(&this_cpu()->ready_queue))
+        thread_yield();
     intr_set_level(old_level);
 }
 
@@ -441,7 +546,7 @@ int thread_get_recent_cpu(void) {
 static void idle(void* idle_started_ UNUSED) {
     struct semaphore* idle_started = idle_started_;
 
-    idle_thread = thread_current();
+    this_cpu()->idle_thread = thread_current();
     sema_up(idle_started);
 
     for (;;) {
@@ -510,13 +615,81 @@ static void init_thread(struct thread* t, const char* name, int priority) {
    will be in the run queue.)  If the run queue is empty, return
    idle_thread. */
 static struct thread* next_thread_to_run(void) {
-    if (list_empty(&ready_list))
-        return idle_thread;
-    else {
-        struct list_elem* max_elem = list_max(&ready_list, thread_priority_max, NULL);
-        list_remove(max_elem);
-        return list_entry(max_elem, struct thread, elem);
+    struct cpu* c = this_cpu();
+
+    if (c->ready_queue.cnt == 0) return c->idle_thread;
+    return ready_queue_pop(&c->ready_queue);
+}
+
+/* Moves blocked thread T to the run queue without preempting
+   the running thread.  Interrupts must be off. */
+static void thread_make_ready(struct thread* t) {
+    ASSERT(intr_get_level() == INTR_OFF);
+    ASSERT(t->status == THREAD_BLOCKED);
+
+    if (thread_mlfqs) {
+        list_remove(&t->mlfqs_elem);
+        mlfqs_update_priority(t);
     }
+    t->status = THREAD_READY;
+    cpu_enqueue(t);
+}
+
+/* Appends T to the run queue.  Interrupts must be off. */
+static void cpu_enqueue(struct thread* t) { ready_queue_push(&bsp.ready_queue, t); }
+
+/* Initializes C with an empty run queue. */
+static void cpu_init(struct cpu* c) {
+    memset(c, 0, sizeof *c);
+    ready_queue_init(&c->ready_queue);
+}
+
+/* Initializes RQ as empty. */
+static void ready_queue_init(struct ready_queue* rq) {
+    int pri;
+
+    for (pri = PRI_MIN; pri <= PRI_MAX; pri++) list_init(&rq->levels[pri]);
+    rq->bitmap = 0;
+    rq->cnt = 0;
+}
+
+/* Appends T to the FIFO of its priority level in RQ.
+   Interrupts must be off. */
+static void ready_queue_push(struct ready_queue* rq, struct thread* t) {
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    list_push_back(&rq->levels[t->priority], &t->elem);
+    rq->bitmap |= 1ULL << t->priority;
+    rq->cnt++;
+}
+
+/* Removes T, which must be in RQ, from its level.
+   Interrupts must be off. */
+static void ready_queue_remove(struct ready_queue* rq, struct thread* t) {
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    list_remove(&t->elem);
+    if (list_empty(&rq->levels[t->priority])) rq->bitmap &= ~(1ULL << t->priority);
+    rq->cnt--;
+}
+
+/* Removes and returns the oldest thread of the highest non-empty
+   level of RQ, which must not be empty. */
+static struct thread* ready_queue_pop(struct ready_queue* rq) {
+    struct thread* t;
+
+    ASSERT(rq->cnt > 0);
+
+    t = list_entry(list_front(&rq->levels[ready_queue_max_priority(rq)]), struct thread, elem);
+    ready_queue_remove(rq, t);
+    return t;
+}
+
+/* Returns the highest priority among RQ's threads, or
+   PRI_MIN - 1 if RQ is empty. */
+static int ready_queue_max_priority(const struct ready_queue* rq) {
+    if (rq->bitmap == 0) return PRI_MIN - 1;
+    return 63 - __builtin_clzll(rq->bitmap);
 }
 
 /* Use iretq to launch the thread */
@@ -635,6 +808,7 @@ static void do_schedule(int status) {
 static void schedule(void) {
     struct thread* curr = running_thread();
     struct thread* next = next_thread_to_run();
+    struct cpu* c = this_cpu();
 
     ASSERT(intr_get_level() == INTR_OFF);
     ASSERT(curr->status != THREAD_RUNNING);
@@ -643,7 +817,8 @@ static void schedule(void) {
     next->status = THREAD_RUNNING;
 
     /* Start new time slice. */
-    thread_ticks = 0;
+    c->curr = next;
+    c->thread_ticks = 0;
 
 #ifdef USERPROG
     /* Activate the new address space. */
@@ -681,30 +856,15 @@ static tid_t allocate_tid(void) {
     return tid;
 }
 
-/// @brief
-/// 두 스레드의 wakeup_tick 값을 비교하여 정렬 순서를 결정한다.
-/// (timer_sleep에서 list_insert_ordered()에 사용됨)
-///
-/// @param e1 첫 번째 리스트 요소의 포인터
-/// @param e2 두 번째 리스트 요소의 포인터
-/// @param aux 추가 인자(사용하지 않음)
-/// @return
-/// e1의 wakeup_tick이 e2보다 작으면 true, 아니면 false
-static bool sleep_list_order(const struct list_elem* e1, const struct list_elem* e2, void* aux) {
-    struct thread* thread1 = list_entry(e1, struct thread, elem);
-    struct thread* thread2 = list_entry(e2, struct thread, elem);
-    return thread1->wakeup_tick < thread2->wakeup_tick;
-}
-
 bool thread_priority_max(const struct list_elem* e1, const struct list_elem* e2, void* aux) {
     struct thread* thread1 = list_entry(e1, struct thread, elem);
     struct thread* thread2 = list_entry(e2, struct thread, elem);
     return thread1->priority <= thread2->priority;
 }
 
-static void mlfqs_update_priority(struct thread* t) {
-    if (t == idle_thread) return;
-
+/* Returns the MLFQS priority T should have given its current
+   recent_cpu and nice values. */
+static int mlfqs_calc_priority(const struct thread* t) {
     /* priority = PRI_MAX - (recent_cpu / 4) - (nice * 2) */
     int new_priority = FP_TO_INT_ZERO(
         FP_SUB_MIXED(FP_SUB(FP_CONST(PRI_MAX), FP_DIV_MIXED(t->recent_cpu, 4)), 2 * t->nice));
@@ -713,40 +873,117 @@ static void mlfqs_update_priority(struct thread* t) {
         new_priority = PRI_MAX;
     else if (new_priority < PRI_MIN)
         new_priority = PRI_MIN;
+    return new_priority;
+}
+
+/* Brings T's recent_cpu up to date and recomputes its priority. */
+static void mlfqs_update_priority(struct thread* t) {
+    if (is_idle_thread(t)) return;
 
-    t->priority = new_priority;
+    mlfqs_catch_up(t);
+    thread_update_priority(t, mlfqs_calc_priority(t));
 }
 
-static void mlfqs_update_recent_cpu(struct thread* t) {
-    if (t == idle_thread) return;
+/* Applies to T every once-per-second recent_cpu decay it has
+   missed, one second at a time so that the fixed-point rounding
+   matches decaying it on time. */
+static void mlfqs_catch_up(struct thread* t) {
+    ASSERT(mlfqs_seconds - t->recent_cpu_epoch <= MLFQS_DECAY_LOG);
 
     /* recent_cpu = (2*load_avg)/(2*load_avg + 1) * recent_cpu + nice */
-    fixed_t coeff = FP_DIV(FP_MUL_MIXED(load_avg, 2), FP_ADD_MIXED(FP_MUL_MIXED(load_avg, 2), 1));
+    while (t->recent_cpu_epoch < mlfqs_seconds) {
+        t->recent_cpu_epoch++;
+        t->recent_cpu = FP_ADD_MIXED(
+            FP_MUL(decay_log[t->recent_cpu_epoch % MLFQS_DECAY_LOG], t->recent_cpu), t->nice);
+    }
+}
 
-    t->recent_cpu = FP_ADD_MIXED(FP_MUL(coeff, t->recent_cpu), t->nice);
+/* Brings a blocked thread T up to date, if MLFQS is in use, so
+   that its priority may be compared with other threads'.  T moves
+   to the back of mlfqs_blocked_list, which stays oldest epoch
+   first. */
+void thread_mlfqs_refresh(struct thread* t) {
+    ASSERT(intr_get_level() == INTR_OFF);
+    ASSERT(t->status == THREAD_BLOCKED);
+
+    if (!thread_mlfqs) return;
+    mlfqs_update_priority(t);
+    if (!is_idle_thread(t)) {
+        list_remove(&t->mlfqs_elem);
+        list_push_back(&mlfqs_blocked_list, &t->mlfqs_elem);
+    }
 }
 
 static void mlfqs_update_load_avg(void) {
     /* load_avg = (59/60)*load_avg + (1/60)*ready_threads */
-    int ready_threads = list_size(&ready_list);
-    if (thread_current() != idle_thread) ready_threads++;
+    int ready_threads = bsp.ready_queue.cnt;
+
+    if (bsp.curr != bsp.idle_thread) ready_threads++;
 
     fixed_t term1 = FP_MUL(FP_DIV_MIXED(FP_CONST(59), 60), load_avg);
     fixed_t term2 = FP_MUL_MIXED(FP_DIV_MIXED(FP_CONST(1), 60), ready_threads);
     load_avg = FP_ADD(term1, term2);
 }
-static void mlfqs_update_recent_cpu_all(void) {
-    struct list_elem* e;
-    for (e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e)) {
-        struct thread* t = list_entry(e, struct thread, allelem);
-        mlfqs_update_recent_cpu(t);
-    }
-}
 
-static void mlfqs_update_priority_all(void) {
-    struct list_elem* e;
-    for (e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e)) {
-        struct thread* t = list_entry(e, struct thread, allelem);
+/* Once-per-second MLFQS work: updates load_avg, logs this
+   second's decay coefficient and decays the running and ready
+   threads.  Blocked threads are left to mlfqs_catch_up(), except
+   those whose missed seconds are about to leave decay_log. */
+static void mlfqs_second(void) {
+    struct cpu* c = this_cpu();
+    int pri;
+
+    while (!list_empty(&mlfqs_blocked_list)) {
+        struct thread* t = list_entry(list_front(&mlfqs_blocked_list), struct thread, mlfqs_elem);
+        if (t->recent_cpu_epoch + MLFQS_DECAY_LOG > mlfqs_seconds + 1) break;
         mlfqs_update_priority(t);
+        list_push_back(&mlfqs_blocked_list, list_pop_front(&mlfqs_blocked_list));
+    }
+
+    mlfqs_update_load_avg();
+    mlfqs_seconds++;
+    decay_log[mlfqs_seconds % MLFQS_DECAY_LOG] =
+        FP_DIV(FP_MUL_MIXED(load_avg, 2), FP_ADD_MIXED(FP_MUL_MIXED(load_avg, 2), 1));
+
+    if (c->curr != c->idle_thread) mlfqs_update_priority(c->curr);
+
+    /* A thread whose priority drops is re-queued at a level not
+       yet visited, where it is visited again; mlfqs_catch_up()
+       makes that second visit a no-op. */
+    for (pri = PRI_MAX; pri >= PRI_MIN; pri--) {
+        struct list_elem* e = list_begin(&c->ready_queue.levels[pri]);
+
+        while (e != list_end(&c->ready_queue.levels[pri])) {
+            struct thread* t = list_entry(e, struct thread, elem);
+            int new_priority;
+
+            e = list_next(e);
+            mlfqs_catch_up(t);
+            new_priority = mlfqs_calc_priority(t);
+            if (new_priority != t->priority) {
+                ready_queue_remove(&c->ready_queue, t);
+                t->priority = new_priority;
+                ready_queue_push(&c->ready_queue, t);
+            }
+        }
     }
 }
+
+/* Notes that T, running on C, was charged a tick. */
+static void mlfqs_charge(struct cpu* c, struct thread* t) {
+    if (c->mlfqs_charged_cnt > 0 && c->mlfqs_charged[c->mlfqs_charged_cnt - 1] == t) return;
+
+    ASSERT(c->mlfqs_charged_cnt < MLFQS_PRI_PERIOD);
+    c->mlfqs_charged[c->mlfqs_charged_cnt++] = t;
+}
+
+/* Recomputes the priority of every thread charged a tick on C
+   since the last recomputation.  No other thread's recent_cpu or
+   nice can have changed in that time. */
+static void mlfqs_update_charged(struct cpu* c) {
+    int i;
+
+    for (i = 0; i < c->mlfqs_charged_cnt; i++)
+        if (c->mlfqs_charged[i] != NULL) mlfqs_update_priority(c->mlfqs_charged[i]);
+    c->mlfqs_charged_cnt = 0;
+}
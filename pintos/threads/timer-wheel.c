@@ -0,0 +1,89 @@
+#include "threads/timer-wheel.h"
+
+#include <debug.h>
+
+/* Mask selecting the slot index within one level. */
+#define TW_MASK (TW_SLOTS - 1)
+
+/* Returns the number of ticks covered by one slot of LEVEL. */
+static inline int64_t level_span(int level) { return (int64_t)1 << (TW_LEVEL_BITS * level); }
+
+/* Initializes W as an empty wheel whose clock reads NOW. */
+void timer_wheel_init(struct timer_wheel* w, int64_t now) {
+    int level, slot;
+
+    for (level = 0; level < TW_LEVELS; level++)
+        for (slot = 0; slot < TW_SLOTS; slot++) list_init(&w->slots[level][slot]);
+    list_init(&w->overflow);
+    w->now = now;
+    w->cnt = 0;
+}
+
+/* Places T in the slot that will be processed at or, for higher
+   levels, cascaded down at its expiry.  Distances are measured
+   from the next tick to be processed; timers that are already
+   due fire on that tick. */
+static void place(struct timer_wheel* w, struct timer* t) {
+    int64_t next = w->now + 1;
+    int64_t expires = t->expires < next ? next : t->expires;
+    int64_t delta = expires - next;
+    int level;
+
+    for (level = 0; level < TW_LEVELS; level++)
+        if (delta < level_span(level + 1)) {
+            int slot = (expires >> (TW_LEVEL_BITS * level)) & TW_MASK;
+            list_push_back(&w->slots[level][slot], &t->elem);
+            return;
+        }
+    list_push_back(&w->overflow, &t->elem);
+}
+
+/* Adds timer T, whose `expires' member must already be set, to W. */
+void timer_wheel_add(struct timer_wheel* w, struct timer* t) {
+    place(w, t);
+    w->cnt++;
+}
+
+/* Removes pending timer T from W. */
+void timer_wheel_cancel(struct timer_wheel* w, struct timer* t) {
+    ASSERT(w->cnt > 0);
+    list_remove(&t->elem);
+    w->cnt--;
+}
+
+/* Re-places every timer of LIST relative to the wheel's clock. */
+static void cascade(struct timer_wheel* w, struct list* list) {
+    struct list pending;
+
+    list_init(&pending);
+    while (!list_empty(list)) list_push_back(&pending, list_pop_front(list));
+    while (!list_empty(&pending))
+        place(w, list_entry(list_pop_front(&pending), struct timer, elem));
+}
+
+/* Advances W's clock to NOW, moving every timer that expires on
+   the way onto EXPIRED in expiry order.  The caller owns the
+   moved timers. */
+void timer_wheel_advance(struct timer_wheel* w, int64_t now, struct list* expired) {
+    while (w->now < now) {
+        int64_t tick = w->now + 1;
+        struct list* due;
+        int level;
+
+        /* Whenever the lower bits of TICK wrap to zero, the slot of
+           the next level up now lies within reach of the level below.
+           Cascade from the top so nothing is placed into a slot that
+           has already been cascaded. */
+        if ((tick & (level_span(TW_LEVELS) - 1)) == 0) cascade(w, &w->overflow);
+        for (level = TW_LEVELS - 1; level > 0; level--)
+            if ((tick & (level_span(level) - 1)) == 0)
+                cascade(w, &w->slots[level][(tick >> (TW_LEVEL_BITS * level)) & TW_MASK]);
+
+        due = &w->slots[0][tick & TW_MASK];
+        while (!list_empty(due)) {
+            list_push_back(expired, list_pop_front(due));
+            w->cnt--;
+        }
+        w->now = tick;
+    }
+}
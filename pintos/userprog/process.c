@@ -644,7 +644,7 @@ static bool lazy_load_segment(struct page* page, void* aux) {
     off_t                   bytes_read;
     
     /* 선제적으로 free 처리(aux는 VM_ANON -> 로드 이후 더 이상 쓸 일이 없음) */
-    free(aux);
+    uninit_aux_free(aux);
 
     kpage = page->frame->kva;
 
@@ -680,46 +680,10 @@ static bool load_segment(struct file* file, off_t ofs, uint8_t* upage, uint32_t
     ASSERT((read_bytes + zero_bytes) % PGSIZE == 0);
     ASSERT(pg_ofs(upage) == 0);
     ASSERT(ofs % PGSIZE == 0);
-    
-    size_t              page_read_bytes;
-    size_t              page_zero_bytes;
-    off_t               page_offset = ofs;
-    void                *aux = NULL;
-    struct uninit_aux   *aux_file = NULL;
 
-    while (read_bytes > 0 || zero_bytes > 0) {
-        /* Do calculate how to fill this page.
-         * We will read PAGE_READ_BYTES bytes from FILE
-         * and zero the final PAGE_ZERO_BYTES bytes. */
-        page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-        page_zero_bytes = PGSIZE - page_read_bytes;
-        aux_file = (struct uninit_aux *)malloc(sizeof(struct uninit_aux));
-        /* TODO : malloc 실패 시 >> 이전 페이지까지의 malloc을 어떻게 처리할까? */
-        if (!aux_file) return false;
-
-        *aux_file = (struct uninit_aux) {
-            .type = UNINIT_AUX_LOAD,
-            .aux_load = (struct uninit_aux_load) {
-                .elf_file = file,
-                .page_pos = page_offset,
-                .page_read_bytes = page_read_bytes,
-                .page_zero_bytes = page_zero_bytes,
-            }
-        };
-        
-        aux = aux_file;
-        if (!vm_alloc_page_with_initializer(VM_ANON, upage, writable, lazy_load_segment, aux)){
-            free(aux_file);
-            return false;
-        }
-
-        /* Advance. */
-        read_bytes -= page_read_bytes;
-        zero_bytes -= page_zero_bytes;
-        upage += PGSIZE;
-        page_offset += PGSIZE;
-    }
-    return true;
+    /* Pages are created from the area as they are faulted in. */
+    return vma_create(&thread_current()->spt, upage, read_bytes + zero_bytes, VM_ANON, writable,
+                      file, ofs, read_bytes, lazy_load_segment) != NULL;
 }
 /* Create a PAGE of stack at the USER_STACK. Return true on success. */
 static bool setup_stack(struct intr_frame* if_) {
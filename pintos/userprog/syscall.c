@@ -56,6 +56,8 @@ static void syscall_close(int fd);
 static int syscall_dup2(int oldfd, int newfd);
 static void *syscall_mmap(void *addr, size_t length, int writable, int fd, off_t offset);
 static void syscall_munmap (void *addr);
+static int syscall_madvise (void *addr, size_t length, int advice);
+static int syscall_msync (void *addr, size_t length, int flags);
 
 void syscall_init(void) {
     write_msr(MSR_STAR, ((uint64_t)SEL_UCSEG - 0x10) << 48 | ((uint64_t)SEL_KCSEG) << 32);
@@ -125,6 +127,12 @@ void syscall_handler(struct intr_frame* f) {
     	case SYS_MUNMAP:
             syscall_munmap(arg1);
             break;
+        case SYS_MADVISE:
+            f->R.rax = syscall_madvise((void *) arg1, arg2, arg3);
+            break;
+        case SYS_MSYNC:
+            f->R.rax = syscall_msync((void *) arg1, arg2, arg3);
+            break;
     }
 }
 
@@ -287,4 +295,14 @@ static void *syscall_mmap(void *addr, size_t length, int writable, int fd, off_t
 static void syscall_munmap (void *addr){
     do_munmap(addr);
     return;
-}
\ No newline at end of file
+}
+
+static int syscall_madvise (void *addr, size_t length, int advice){
+    if(!is_user_vaddr(addr) || !is_user_vaddr(addr + length)) return -1;
+    return vm_madvise(addr, length, advice) ? 0 : -1;
+}
+
+static int syscall_msync (void *addr, size_t length, int flags){
+    if(!is_user_vaddr(addr) || !is_user_vaddr(addr + length)) return -1;
+    return vm_msync(addr, length, flags) ? 0 : -1;
+}
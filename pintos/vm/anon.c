@@ -1,16 +1,51 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
 #include "vm/vm.h"
+#include "vm/zswap.h"
 #include "threads/vaddr.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/malloc.h"
 #include "devices/disk.h"
+#include <bitmap.h>
 #include <string.h>
 
+/* Number of swap disk sectors holding one page. */
+#define SECTORS_PER_PAGE (PGSIZE / DISK_SECTOR_SIZE)
+
+/* Slots a process starts filling together.  The swap disk is
+ * divided into aligned clusters of SWAP_CLUSTER slots, each owned
+ * by at most one process at a time.  Pages evicted from a process
+ * take consecutive slots of the cluster it owns, so that pages
+ * evicted in address order, as the clock does for a sequential
+ * sweep, can be read back in one pass. */
+#define SWAP_CLUSTER 16
+
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
 static bool anon_swap_in (struct page *page, void *kva);
 static bool anon_swap_out (struct page *page);
 static void anon_destroy (struct page *page);
 
+/* Swap slots, one bit per page-sized run of sectors on
+ * swap_disk.  A set bit means the slot is in use.  A slot written
+ * out from a frame shared after fork is referenced by every
+ * sharer; slot_refs counts them. */
+static struct bitmap *swap_table;
+static unsigned *slot_refs;
+static struct lock swap_lock;
+
+/* Owner of each whole cluster of swap_table, or NULL.  A cluster
+ * is handed out only when all of its slots are free, and is given
+ * up when they are all free again.  Protected by swap_lock. */
+static struct supplemental_page_table **cluster_owner;
+static size_t cluster_cnt;
+
+static size_t swap_slot_alloc (struct page *page, unsigned refs);
+static void swap_slot_read (size_t slot, void *kva);
+static void swap_slot_free (size_t slot);
+static void anon_slot_release (struct anon_page *anon_page);
+
 /* DO NOT MODIFY this struct */
 static const struct page_operations anon_ops = {
 	.swap_in = anon_swap_in,
@@ -24,6 +59,16 @@ void
 vm_anon_init (void) {
 	swap_disk = disk_get(1, 1);
 	ASSERT(swap_disk != NULL);
+
+	size_t slot_cnt = disk_size (swap_disk) / SECTORS_PER_PAGE;
+	swap_table = bitmap_create (slot_cnt);
+	slot_refs = calloc (slot_cnt, sizeof *slot_refs);
+	cluster_cnt = slot_cnt / SWAP_CLUSTER;
+	cluster_owner = calloc (cluster_cnt + 1, sizeof *cluster_owner);
+	if (swap_table == NULL || slot_refs == NULL || cluster_owner == NULL)
+		PANIC ("cannot allocate swap table");
+	lock_init (&swap_lock);
+	zswap_init ();
 }
 
 /* Initialize the file mapping */
@@ -33,28 +78,183 @@ anon_initializer (struct page *page, enum vm_type type, void *kva) {
 	page->operations = &anon_ops;
 
 	struct anon_page *anon_page = &page->anon;
+	anon_page->swap_slot = SWAP_SLOT_NONE;
+	anon_page->compressed = false;
+	return true;
+}
+
+/* Allocates a swap slot for PAGE, shared by REFS pages, and
+ * returns it, or BITMAP_ERROR if swap is full.  Takes the slot
+ * after the one its owner last got, if that is still in a cluster
+ * the owner holds, or else takes over a free cluster.  With no
+ * free cluster left, any free slot will do. */
+static size_t
+swap_slot_alloc (struct page *page, unsigned refs) {
+	struct supplemental_page_table *spt = &page->owner->spt;
+	size_t slot, c;
+
+	lock_acquire (&swap_lock);
+	slot = spt->swap_next;
+	if (slot == SWAP_SLOT_NONE || slot % SWAP_CLUSTER == 0
+			|| slot >= cluster_cnt * SWAP_CLUSTER
+			|| cluster_owner[slot / SWAP_CLUSTER] != spt
+			|| bitmap_test (swap_table, slot)) {
+		slot = BITMAP_ERROR;
+		for (c = 0; c < cluster_cnt; c++)
+			if (cluster_owner[c] == NULL && bitmap_none (swap_table,
+						c * SWAP_CLUSTER, SWAP_CLUSTER)) {
+				cluster_owner[c] = spt;
+				slot = c * SWAP_CLUSTER;
+				break;
+			}
+	}
+	if (slot == BITMAP_ERROR)
+		slot = bitmap_scan (swap_table, 0, 1, false);
+	if (slot != BITMAP_ERROR) {
+		bitmap_mark (swap_table, slot);
+		slot_refs[slot] = refs;
+		spt->swap_next = slot + 1;
+	}
+	lock_release (&swap_lock);
+	return slot;
+}
+
+/* Returns the swap disk slot holding PAGE, or SWAP_SLOT_NONE if
+ * PAGE is not an anonymous page evicted to the swap disk. */
+size_t
+anon_disk_slot (struct page *page) {
+	if (page->operations != &anon_ops || page->frame != NULL
+			|| page->anon.compressed)
+		return SWAP_SLOT_NONE;
+	return page->anon.swap_slot;
+}
+
+/* Reads swap slot SLOT into the page at KVA. */
+static void
+swap_slot_read (size_t slot, void *kva) {
+	for (int i = 0; i < SECTORS_PER_PAGE; i++)
+		disk_read (swap_disk, slot * SECTORS_PER_PAGE + i,
+				kva + i * DISK_SECTOR_SIZE);
+}
+
+/* Drops one reference to swap slot SLOT, returning it to the
+ * free pool with the last one. */
+static void
+swap_slot_free (size_t slot) {
+	lock_acquire (&swap_lock);
+	ASSERT (bitmap_test (swap_table, slot));
+	ASSERT (slot_refs[slot] > 0);
+	if (--slot_refs[slot] == 0) {
+		size_t c = slot / SWAP_CLUSTER;
+
+		bitmap_reset (swap_table, slot);
+		if (c < cluster_cnt
+				&& bitmap_none (swap_table, c * SWAP_CLUSTER, SWAP_CLUSTER))
+			cluster_owner[c] = NULL;
+	}
+	lock_release (&swap_lock);
+}
+
+/* Drops ANON_PAGE's reference to its copy in swap, if any. */
+static void
+anon_slot_release (struct anon_page *anon_page) {
+	if (anon_page->swap_slot == SWAP_SLOT_NONE)
+		return;
+	if (anon_page->compressed)
+		zswap_unref (anon_page->swap_slot);
+	else
+		swap_slot_free (anon_page->swap_slot);
+	anon_page->swap_slot = SWAP_SLOT_NONE;
+	anon_page->compressed = false;
 }
 
 /* Swap in the page by read contents from the swap disk. */
 static bool
 anon_swap_in (struct page *page, void *kva) {
 	struct anon_page *anon_page = &page->anon;
+
+	/* No copy anywhere: a zero-fill page being claimed, or one
+	 * dropped by MADV_DONTNEED. */
+	if (anon_page->swap_slot == SWAP_SLOT_NONE) {
+		memset (kva, 0, PGSIZE);
+		return true;
+	}
+
+	if (anon_page->compressed)
+		zswap_load (anon_page->swap_slot, kva);
+	else {
+		swap_slot_read (anon_page->swap_slot, kva);
+		zswap_note_disk_load ();
+	}
+	anon_slot_release (anon_page);
 	return true;
 }
 
-/* Swap out the page by writing contents to the swap disk. */
+/* Swap out the page to the compressed pool, or to the swap disk
+ * if it does not fit there.  Every page sharing PAGE's frame is
+ * evicted with it and shares the one copy.  Runs without
+ * frame_lock; the caller detaches the pages from the frame. */
 static bool
 anon_swap_out (struct page *page) {
-	struct anon_page *anon_page = &page->anon;
+	struct frame *frame = page->frame;
+	void *kva = frame->kva;
+	struct list_elem *e;
+	bool compressed;
+	size_t slot;
+
+	/* Unmap first so the owners fault, rather than write, while
+	 * the contents are on their way out. */
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *p = list_entry (e, struct page, frame_elem);
+		pml4_clear_page (p->owner->pml4, p->va);
+	}
+
+	compressed = zswap_store (kva, frame->ref_cnt, &slot);
+	if (!compressed) {
+		slot = swap_slot_alloc (page, frame->ref_cnt);
+		if (slot == BITMAP_ERROR) {
+			/* Nowhere to put it: map it back as it was. */
+			for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+					e = list_next (e)) {
+				struct page *p = list_entry (e, struct page, frame_elem);
+				pml4_set_page (p->owner->pml4, p->va, kva,
+						p->writable && frame->ref_cnt == 1);
+			}
+			return false;
+		}
+		for (int i = 0; i < SECTORS_PER_PAGE; i++)
+			disk_write (swap_disk, slot * SECTORS_PER_PAGE + i,
+					kva + i * DISK_SECTOR_SIZE);
+	}
+
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *p = list_entry (e, struct page, frame_elem);
+		p->anon.swap_slot = slot;
+		p->anon.compressed = compressed;
+	}
+	return true;
+}
+
+/* Drops PAGE's contents, in memory and in swap, so that it reads
+ * back as zeros. */
+void
+anon_discard (struct page *page) {
+	vm_free_frame (page);
+	anon_slot_release (&page->anon);
 }
 
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 anon_destroy (struct page *page) {
-	struct anon_page *anon_page = &page->anon;
+	anon_discard (page);
 }
 
 
+/* Copies SRC_PAGE into DST at fork, copy-on-write.  A resident
+ * page shares its frame read-only; an evicted one shares its swap
+ * slot.  Nothing is copied until one side writes. */
 bool
 anon_copy(struct supplemental_page_table *dst, struct page *src_page) {
 	struct page	*dst_page = NULL;
@@ -65,10 +265,30 @@ anon_copy(struct supplemental_page_table *dst, struct page *src_page) {
 	if (!dst_page)
 		return false;
 
-	if (src_page->frame)
-	{
-		vm_claim_page(dst_page->va);
-		memcpy(dst_page->frame->kva, src_page->frame->kva, PGSIZE);
+	/* Turn the pending page straight into an anonymous one. */
+	dst_page->operations = &anon_ops;
+	dst_page->anon.swap_slot = SWAP_SLOT_NONE;
+	dst_page->anon.compressed = false;
+
+	if (vm_share_frame (dst_page, src_page))
+		return true;
+	if (src_page->frame != NULL)
+		return false;
+
+	/* Not resident: the parent is blocked in fork, so it cannot
+	 * swap the page back in under us.  Without a swap slot either,
+	 * it was dropped or never filled, and the copy is zero-fill
+	 * like it. */
+	if (src_page->anon.swap_slot == SWAP_SLOT_NONE)
+		return true;
+	if (src_page->anon.compressed)
+		zswap_ref (src_page->anon.swap_slot);
+	else {
+		lock_acquire (&swap_lock);
+		slot_refs[src_page->anon.swap_slot]++;
+		lock_release (&swap_lock);
 	}
+	dst_page->anon.swap_slot = src_page->anon.swap_slot;
+	dst_page->anon.compressed = src_page->anon.compressed;
 	return true;
-}
\ No newline at end of file
+}
@@ -4,8 +4,19 @@
 #include <round.h>
 #include "threads/vaddr.h"
 #include "userprog/syscall.h"
+#include "threads/malloc.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "threads/mmu.h"
+#include "threads/palloc.h"
+
+/* Most pages gathered into one write by file_writeback_pages(). */
+#define WB_BATCH_PAGES 16
+
+/* Statistics. */
+static long long wb_page_cnt;		/* Pages written by file_writeback_pages(). */
+static long long wb_write_cnt;		/* ...and the writes it took. */
 
 static bool file_backed_swap_in (struct page *page, void *kva);
 static bool file_backed_swap_out (struct page *page);
@@ -13,9 +24,14 @@ static void file_backed_destroy (struct page *page);
 
 
 /* Helper Function */
-static bool valid_vma_range(uintptr_t vaild_addr_ptr, size_t valid_length);
 static bool file_load(struct page* page, void* aux);
+static void file_page_setup (struct page *page, struct uninit_aux *aux);
+static bool read_page (struct file_page *file_page, void *kva);
 static void write_back(struct page *page);
+static int page_pos_cmp (const void *a, const void *b);
+static bool page_follows (const struct page *prev, const struct page *page);
+static void write_run (struct file *file, struct page **run, size_t cnt,
+		uint8_t *buf);
 
 
 /* DO NOT MODIFY this struct */
@@ -36,31 +52,122 @@ bool
 file_backed_initializer (struct page *page, enum vm_type type, void *kva) {
 	/* Set up the handler */
 	page->operations = &file_ops;
-	struct file_page *file_page = &page->file;
+	return true;
 }
 
 /* Swap in the page by read contents from the file. */
 static bool
 file_backed_swap_in (struct page *page, void *kva) {
-	struct file_page *file_page UNUSED = &page->file;
+	return read_page (&page->file, kva);
 }
 
-/* Swap out the page by writeback contents to the file. */
+/* Reads the page described by FILE_PAGE into KVA.  Bytes past the
+ * end of the file read as zeros. */
+static bool
+read_page (struct file_page *file_page, void *kva) {
+	off_t bytes_read = file_read_at (file_page->mapped_file, kva,
+			file_page->read_bytes, file_page->pos);
+
+	if (bytes_read < 0)
+		return false;
+	memset (kva + bytes_read, 0, PGSIZE - bytes_read);
+	return true;
+}
+
+/* Swap out the page by writeback contents to the file.
+ * Every page sharing PAGE's frame, in any process, is evicted
+ * with it, and the frame is written back once if any of them, or
+ * a mapping already gone, wrote to it.  Runs without frame_lock;
+ * the caller detaches the pages from the frame. */
 static bool
 file_backed_swap_out (struct page *page) {
-	struct file_page *file_page UNUSED = &page->file;
+	struct frame *frame = page->frame;
+	bool dirty = frame->dirty;
+	struct list_elem *e;
+
+	/* Unmap first so no owner can dirty it again mid-write. */
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *p = list_entry (e, struct page, frame_elem);
+		dirty |= pml4_is_dirty (p->owner->pml4, p->va);
+		pml4_clear_page (p->owner->pml4, p->va);
+	}
+	if (dirty)
+		write_back (page);
+	frame->dirty = false;
+	return true;
 }
 
-/* Destory the file backed page. PAGE will be freed by the caller. */
+/* Destory the file backed page. PAGE will be freed by the caller.
+ * A frame shared with other mappings is written back only when
+ * the last of them goes. */
 static void
 file_backed_destroy (struct page *page) {
-	struct file_page *file_page = &page->file;
+	/* A page that is not resident was written back on eviction. */
+	if (vm_pin_page_if_resident (page)) {
+		if (vm_frame_take_dirty (page))
+			write_back (page);
+		/* No-op if the page already left a shared frame. */
+		vm_unpin_page (page);
+	}
+	vm_free_frame (page);
+}
+
+/* Copies SRC_PAGE into DST at fork.  The copy maps the file
+ * through DST's copy of the area and shares SRC_PAGE's frame if it
+ * is resident; otherwise it is read back from the file, or found
+ * in the file page index, on its first fault. */
+bool
+file_copy (struct supplemental_page_table *dst, struct page *src_page) {
+	struct page *dst_page;
+	struct vma *vma = vma_find (dst, src_page->va);
+
+	if (vma == NULL)
+		return false;
+	if (!vm_alloc_page (VM_FILE, src_page->va, src_page->writable))
+		return false;
+	dst_page = spt_find_page (dst, src_page->va);
+
+	dst_page->operations = &file_ops;
+	dst_page->file = src_page->file;
+	dst_page->file.mapped_file = vma->file;
+
+	if (!vm_share_frame (dst_page, src_page) && src_page->frame != NULL)
+		return false;
+	return true;
+}
 
-	if(pml4_is_dirty(thread_current()->pml4, page->va))
-		write_back(page);
+/* If PAGE holds, or is waiting to load, a page of a memory-mapped
+ * file, fills in KEY to identify it and returns true. */
+bool
+file_page_key (struct page *page, struct file_key *key) {
+	if (page->operations == &file_ops) {
+		key->inode = file_get_inode (page->file.mapped_file);
+		key->pos = page->file.pos;
+		key->read_bytes = page->file.read_bytes;
+		return true;
+	}
+	if (page->operations->type == VM_UNINIT && page->uninit.init == file_load) {
+		struct uninit_aux_file *aux_file =
+			&((struct uninit_aux *) page->uninit.aux)->aux_file;
+
+		key->inode = file_get_inode (aux_file->file);
+		key->pos = aux_file->page_pos;
+		key->read_bytes = aux_file->page_read_bytes;
+		return true;
+	}
+	return false;
+}
 
-	if(file_page->mapped_file == NULL) return;
-	file_close(file_page->mapped_file);
+/* Turns PAGE, which file_page_key() accepted, into a file-backed
+ * page without loading it, because it is being mapped onto a
+ * frame that already holds its contents. */
+void
+file_page_adopt (struct page *page) {
+	if (page->operations->type != VM_UNINIT)
+		return;
+	page->uninit.page_initializer (page, page->uninit.type, NULL);
+	file_page_setup (page, page->uninit.aux);
 }
 
 /* When evicted from physical memory */
@@ -74,126 +181,161 @@ static void write_back(struct page *page){
 }
 
 
-static void *get_group_number(struct page *page){
-	if(page->operations->type == VM_FILE){
-		return page->file.mmap_base;
-	} else if (page->operations->type == VM_UNINIT){
-		struct uninit_aux *aux = page->uninit.aux;
-		return aux->aux_file.mmap_base;
+static bool file_load(struct page* page, void* aux){
+	bool success;
+
+	file_page_setup(page, aux);
+	lock_acquire(&file_lock);
+	success = read_page(&page->file, page->frame->kva);
+	lock_release(&file_lock);
+	return success;
+}
+
+/* Fills in PAGE's file_page from its loader arguments AUX, which
+ * are freed. */
+static void
+file_page_setup (struct page *page, struct uninit_aux *aux) {
+	struct uninit_aux_file *aux_file = &aux->aux_file;
+
+	page->file = (struct file_page) {
+		.mapped_file = aux_file->file,
+		.mmap_base = aux_file->mmap_base,
+		.pos = aux_file->page_pos,
+		.read_bytes = aux_file->page_read_bytes,
+		.zero_bytes = aux_file->page_zero_bytes,
+	};
+	uninit_aux_free (aux);
+}
+
+/* Writes back the dirty pages of file mapping VMA in [START, END),
+ * for msync() or before the area's pages are destroyed one at a
+ * time.  Clean pages are skipped.  Pages this misses, for lack of
+ * memory, are still written back when destroyed. */
+void
+file_writeback_area (struct vma *vma, void *start, void *end) {
+	struct page **dirty;
+	struct list_elem *e;
+	size_t cnt = 0, i;
+
+	if (list_empty (&vma->pages))
+		return;
+	dirty = malloc (list_size (&vma->pages) * sizeof *dirty);
+	if (dirty == NULL)
+		return;
+
+	for (e = list_begin (&vma->pages); e != list_end (&vma->pages);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, vma_elem);
+
+		if (page->operations != &file_ops || page->va < start
+				|| page->va >= end || !vm_pin_page_if_resident (page))
+			continue;
+		if (vm_frame_clean (page))
+			dirty[cnt++] = page;
+		else
+			vm_unpin_page (page);
 	}
-	return NULL;
+	file_writeback_pages (dirty, cnt);
+
+	for (i = 0; i < cnt; i++)
+		vm_unpin_page (dirty[i]);
+	free (dirty);
 }
 
-/* 요청한 vma가 연속된 free인지 확인(SPT CHECK) */
-static bool valid_vma_range(uintptr_t vaild_addr_ptr, size_t valid_length){
-	struct thread *cur = thread_current();
-	while(valid_length > 0){
-		if(spt_find_page(&cur->spt, vaild_addr_ptr)) return NULL;
-		size_t move_bytes = (PGSIZE < valid_length) ? PGSIZE : valid_length; 
-		vaild_addr_ptr += move_bytes;
-		valid_length -= move_bytes;
+/* Writes the CNT file pages at PAGES, whose frames the caller
+ * pinned and cleaned, back to their files.  The pages are sorted
+ * by file and offset, and each run of adjacent pages is written
+ * with one call, up to WB_BATCH_PAGES at a time. */
+void
+file_writeback_pages (struct page **pages, size_t cnt) {
+	uint8_t *buf;
+	size_t i, j;
+
+	qsort (pages, cnt, sizeof *pages, page_pos_cmp);
+
+	/* Without a buffer, pages are still written in file order. */
+	buf = cnt > 1 ? palloc_get_multiple (0, WB_BATCH_PAGES) : NULL;
+	lock_acquire (&file_lock);
+	for (i = 0; i < cnt; i = j) {
+		for (j = i + 1; j < cnt && buf != NULL && j - i < WB_BATCH_PAGES
+				&& page_follows (pages[j - 1], pages[j]); j++)
+			continue;
+		write_run (pages[i]->file.mapped_file, pages + i, j - i, buf);
 	}
-	return true;
+	lock_release (&file_lock);
+	if (buf != NULL)
+		palloc_free_multiple (buf, WB_BATCH_PAGES);
 }
 
-static bool file_load(struct page* page, void* aux){
-	void *kpage = page->frame->kva;
-	struct uninit_aux_file *aux_file = &(((struct uninit_aux *) aux)->aux_file);
-	struct file *mapped_file = aux_file->file;
-	off_t pos = aux_file->page_pos;
-	size_t read_bytes = aux_file->page_read_bytes;
-	size_t zero_bytes = aux_file->page_zero_bytes;
-	void *mmap_base = aux_file->mmap_base;
-	free(aux);
-
-	struct file_page *file_page = &page->file;
-	*file_page = (struct file_page){
-		.mapped_file = mapped_file,
-		.mmap_base = mmap_base,
-		.pos = pos,
-		.read_bytes = read_bytes,
-		.zero_bytes = zero_bytes,
-	};
+/* Orders pointers to file pages by file, then by file offset. */
+static int
+page_pos_cmp (const void *a, const void *b) {
+	const struct page *pa = *(struct page * const *) a;
+	const struct page *pb = *(struct page * const *) b;
+	struct inode *ia = file_get_inode (pa->file.mapped_file);
+	struct inode *ib = file_get_inode (pb->file.mapped_file);
+
+	if (ia != ib)
+		return ia < ib ? -1 : 1;
+	return pa->file.pos < pb->file.pos ? -1 : pa->file.pos > pb->file.pos;
+}
 
-	lock_acquire(&file_lock);
-	file_read_at(mapped_file, kpage, read_bytes, pos);
-	lock_release(&file_lock);
+/* Returns true if file page PAGE directly follows the full page
+ * PREV in the same file. */
+static bool
+page_follows (const struct page *prev, const struct page *page) {
+	return file_get_inode (prev->file.mapped_file)
+			== file_get_inode (page->file.mapped_file)
+		&& prev->file.read_bytes == PGSIZE
+		&& page->file.pos == prev->file.pos + PGSIZE;
+}
 
-	memset(kpage + read_bytes, 0, zero_bytes);
-	return true;
+/* Writes the CNT pinned pages at RUN, which are adjacent in FILE,
+ * with a single write, copying them through BUF if there are
+ * several.  Any mapping of the run's file will do for FILE. */
+static void
+write_run (struct file *file, struct page **run, size_t cnt, uint8_t *buf) {
+	size_t length, i;
+
+	wb_page_cnt += cnt;
+	wb_write_cnt++;
+	if (cnt == 1) {
+		file_write_at (file, run[0]->frame->kva, run[0]->file.read_bytes,
+				run[0]->file.pos);
+		return;
+	}
+	for (i = 0; i < cnt; i++)
+		memcpy (buf + i * PGSIZE, run[i]->frame->kva, run[i]->file.read_bytes);
+	length = (cnt - 1) * PGSIZE + run[cnt - 1]->file.read_bytes;
+	file_write_at (file, buf, length, run[0]->file.pos);
+}
+
+/* Prints write-back statistics. */
+void
+file_print_stats (void) {
+	printf ("File write-back: %lld dirty pages in %lld writes\n",
+			wb_page_cnt, wb_write_cnt);
 }
 
 /* Do the mmap */
 void *
 do_mmap (void *addr, size_t length, int writable,
 		struct file *file, off_t offset) {
-	uint8_t* upage = (uint8_t *)addr;
-	off_t ofs = offset;
-	struct uninit_aux *aux_file = NULL;
-	void *aux = NULL;
-
-	if(!valid_vma_range(addr, length)) return NULL;
-
-	size_t read_bytes = length;
-	size_t page_cnt = DIV_ROUND_UP(length, PGSIZE);
-
-	for(size_t i = 0; i < page_cnt; i++){
-		size_t page_read_bytes = (read_bytes < PGSIZE) ? read_bytes : PGSIZE;
-		size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-		struct file *d_file = file_reopen(file);
-		if(!d_file) return NULL;
-
-
-		/* aux 생성 */
-		aux_file = (struct uninit_aux *)malloc(sizeof(struct uninit_aux));
-		*aux_file = (struct uninit_aux) {
-			.type = UNINIT_AUX_FILE,
-			.aux_file = (struct uninit_aux_file) {
-				.file = d_file,
-				.mmap_base = addr, 
-				.page_pos = ofs,
-				.page_read_bytes = page_read_bytes,
-				.page_zero_bytes = page_zero_bytes,
-			}
-		};
-
-		aux = aux_file;
-		if(!vm_alloc_page_with_initializer(VM_FILE, upage, writable, file_load, aux)){
-			free(aux_file);
-			/* TODO : 중간에 실패시 지금까지 해온거 FREE 해야 함  */
-			return NULL;
-		}
-
-		/* Advance. */
-		read_bytes -= page_read_bytes;
-		upage += PGSIZE;
-		ofs += PGSIZE;
-	}
+	struct supplemental_page_table *spt = &thread_current ()->spt;
 
-	/* 포인터 할당 */
+	if (vma_create (spt, addr, length, VM_FILE, writable, file, offset,
+				length, file_load) == NULL)
+		return NULL;
 	return addr;
-
 }
 
 /* Do the munmap */
 void
 do_munmap (void *addr) {
-	struct supplemental_page_table *spt = &thread_current()->spt;
-	struct page *pivot_page = spt_find_page(spt, addr);
-	struct page *page = NULL;
-	void *cur_addr = addr;
-	if(pivot_page == NULL || page_get_type(pivot_page) != VM_FILE) return;
-	void *group_number = get_group_number(pivot_page);
-
-	/* spt 찾고 file_backed인지 확인 */
-	while(true){
-		page = spt_find_page(spt, addr);
-		if(page == NULL || page_get_type(page) != VM_FILE) break;
-
-		if(get_group_number(page) != group_number) break;
-		spt_remove_page(spt, page);
-		addr += PGSIZE;
-	}
-	return;
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct vma *vma = vma_find (spt, addr);
+
+	if (vma == NULL || vma->start != addr || VM_TYPE (vma->type) != VM_FILE)
+		return;
+	vma_unmap (spt, vma);
 }
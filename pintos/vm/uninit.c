@@ -10,14 +10,20 @@
 
 #include "vm/vm.h"
 #include <stdbool.h>
+#include <string.h>
 #include "vm/uninit.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "userprog/syscall.h"
+#include "threads/malloc.h"
+#include "threads/slab.h"
 
 static bool uninit_initialize (struct page *page, void *kva);
 static void uninit_destroy (struct page *page);
 
+/* Cache of loader arguments, one per pending area page. */
+static struct kmem_cache *aux_cache;
+
 /* DO NOT MODIFY this struct */
 static const struct page_operations uninit_ops = {
 	.swap_in = uninit_initialize,
@@ -26,6 +32,26 @@ static const struct page_operations uninit_ops = {
 	.type = VM_UNINIT,
 };
 
+/* Creates the cache for loader arguments. */
+void
+vm_uninit_init (void) {
+	aux_cache = kmem_cache_create ("uninit_aux", sizeof (struct uninit_aux),
+			NULL);
+}
+
+/* Allocates loader arguments.  Returns NULL if memory is not
+ * available. */
+struct uninit_aux *
+uninit_aux_alloc (void) {
+	return kmem_cache_alloc (aux_cache);
+}
+
+/* Frees AUX, from uninit_aux_alloc(). */
+void
+uninit_aux_free (struct uninit_aux *aux) {
+	kmem_cache_free (aux_cache, aux);
+}
+
 /* DO NOT MODIFY this function */
 void
 uninit_new (struct page *page, void *va, vm_initializer *init,
@@ -65,73 +91,30 @@ uninit_initialize (struct page *page, void *kva) {
  * PAGE will be freed by the caller. */
 static void
 uninit_destroy (struct page *page) {
-	struct uninit_page *uninit = &page->uninit;
-	struct uninit_aux *aux_uninit = page->uninit.aux;
-	if (aux_uninit){		
-		if(aux_uninit->type == UNINIT_AUX_FILE){
-			file_close(aux_uninit->aux_file.file);
-		} 
-		free (page->uninit.aux);
-		page->uninit.aux = NULL;
-	}
-}
-
-bool 
-uninit_aux_load_copy(struct supplemental_page_table *dst, struct page *src_page) {
-	struct file				*current_file_copy = NULL;
-	struct uninit_aux		*aux = NULL;
-
-
-	current_file_copy = thread_current()->current_file;
-
-	aux = (struct uninit_aux *)calloc(1, sizeof(struct uninit_aux));
-	if (!aux) return false;
-
-	memcpy(aux, src_page->uninit.aux, sizeof(struct uninit_aux));
-	aux->aux_load.elf_file = current_file_copy;
-
-	if (!vm_alloc_page_with_initializer(
-		src_page->uninit.type, src_page->va, src_page->writable,
-		src_page->uninit.init, aux
-	)) return false;
-
-	return true;
-}
-
-bool 
-uninit_aux_file_copy(struct supplemental_page_table *dst, struct page *src_page) {
-	return true;
+	/* A file named in the loader arguments belongs to the page's
+	 * area, which closes it. */
+	uninit_aux_free (page->uninit.aux);
+	page->uninit.aux = NULL;
 }
 
 bool 
 uninit_aux_anon_copy(struct supplemental_page_table *dst, struct page *src_page) {
-	struct page	*dst_page;
-
 	if (!vm_alloc_page_with_initializer(src_page->uninit.type, src_page->va, src_page->writable, src_page->uninit.init, src_page->uninit.aux))
 		return false;
 
 	return true;
 }
 
+/* Copies a pending page that does not belong to an area, such as
+ * a stack page not touched yet.  Pending pages of areas are not
+ * copied; the child creates them from its copy of the area. */
 bool uninit_copy(struct supplemental_page_table *dst, struct page *src_page) {
-	enum uninit_aux_type	aux_type;
+	struct uninit_aux		*aux;
 
 	if (!dst || !src_page) return false;  
 
-	aux_type = ((struct uninit_aux *)(src_page->uninit.aux))->type;
-
-	switch (aux_type)
-	{
-		case UNINIT_AUX_LOAD:
-			if (false == uninit_aux_load_copy(dst, src_page)) return false;
-			break ;
-		case UNINIT_AUX_FILE:
-			if (false == uninit_aux_file_copy(dst, src_page)) return false;
-			break ;
-		case UNINIT_AUX_ANON:
-			if (false == uninit_aux_anon_copy(dst, src_page)) return false;
-			break ;	
-	}
+	aux = src_page->uninit.aux;
+	ASSERT (aux == NULL || aux->type == UNINIT_AUX_ANON);
 
-	return true;
+	return uninit_aux_anon_copy(dst, src_page);
 }
@@ -1,13 +1,107 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
+#include "vm/zswap.h"
 #include "threads/vaddr.h"
 #include <hash.h>
+#include <round.h>
 #include <stdbool.h>
+#include <syscall-nr.h>
+#include <stdio.h>
 #include <string.h>
 #include "threads/mmu.h"
+#include "threads/synch.h"
+#include "devices/timer.h"
+
+/* Frame table: every frame holding a user page, in the order
+ * the clock hand sweeps them.  Protected by frame_lock.  Eviction
+ * and the flusher drop the lock while they write a frame out;
+ * anyone who must wait for that waits on frame_io_done.  See
+ * frame_wait() and frame_wait_idle(). */
+static struct list frame_table;
+static struct list_elem *clock_hand;
+static struct lock frame_lock;
+static struct condition frame_io_done;
+
+/* File page index: every resident frame holding a page of a
+ * memory-mapped file, keyed by the file's inode and the page's
+ * offset, so that all mappings of the page share one frame and
+ * see each other's writes.  Protected by frame_lock. */
+static struct hash file_index;
+static long long file_share_cnt;    /* Faults served from the index. */
+
+/* A page of zeros shared read-only by every anonymous page that
+ * has been read but never written.  It is not in the frame table,
+ * so it is never evicted or freed. */
+static struct frame zero_frame_store;
+static struct frame *zero_frame = &zero_frame_store;
+
+/* Reclaim daemon.  Faulting threads wake it when free user frames
+ * drop below vm_wmark_low; it evicts frames and frees them until
+ * vm_wmark_high are free, so most faults find a free frame instead
+ * of waiting on a swap-out.  KSWAPD_AWAKE is protected by
+ * frame_lock. */
+size_t vm_wmark_low = VM_WMARK_LOW_DEFAULT;
+size_t vm_wmark_high = VM_WMARK_HIGH_DEFAULT;
+static struct semaphore kswapd_sema;
+static bool kswapd_awake;
+
+/* Reclaim statistics, protected by frame_lock. */
+static long long frame_alloc_cnt;   /* Frames handed out. */
+static long long direct_cnt;        /* ...that had to evict one. */
+static long long kswapd_wake_cnt;   /* Daemon wakeups. */
+static long long kswapd_free_cnt;   /* Frames it freed. */
+
+static void kswapd (void *aux);
+static void flusher (void *aux);
+static bool frame_clean (struct frame *frame);
+static void frame_dirtied (struct frame *frame);
+
+/* Object caches for pages and frames, which are allocated and
+ * freed on every fault and eviction. */
+static struct kmem_cache *page_cache;
+static struct kmem_cache *frame_cache;
+
+static void frame_ctor (void *frame);
+static uint64_t index_hash (const struct hash_elem *e, void *aux);
+static bool index_less (const struct hash_elem *a,
+		const struct hash_elem *b, void *aux);
+
+/* Fault-around window, set by the -fa kernel option.  Memory
+ * mappings use it only if the option was given. */
+int vm_fault_around = VM_FAULT_AROUND_DEFAULT;
+bool vm_fault_around_mmap;
+
+/* Swap readahead window, set by the -sra kernel option. */
+int vm_swap_readahead = VM_SWAP_READAHEAD_DEFAULT;
+
+/* Dirty page age and flusher period, set by the -flush kernel
+ * option. */
+int vm_flush_age = VM_FLUSH_AGE_DEFAULT;
+int vm_flush_period = VM_FLUSH_PERIOD_DEFAULT;
+
+/* Flusher.  It sleeps on flusher_sema until a write through a
+ * file mapping starts the clock on a frame; see frame_dirtied().
+ * The rest is protected by frame_lock. */
+static struct semaphore flusher_sema;
+static bool flusher_awake;
+static bool flush_again;            /* Woken during a pass. */
+static long long flush_cnt;         /* Pages written back. */
+
+/* Most frames the flusher writes back at a time: a page of page
+ * pointers. */
+#define FLUSH_BATCH (PGSIZE / sizeof (struct page *))
+
+/* Fault-around and swap readahead statistics.  A prefetched page
+ * counts as a saved fault once it is seen accessed, or as wasted
+ * if it is evicted or freed before that. */
+static long long fa_prefetch_cnt;
+static long long sra_prefetch_cnt;
+static long long fa_saved_cnt;
+static long long fa_wasted_cnt;
 
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
@@ -20,7 +114,46 @@ vm_init (void) {
 #endif
 	register_inspect_intr ();
 	/* DO NOT MODIFY UPPER LINES. */
-	/* TODO: Your code goes here. */
+	list_init (&frame_table);
+	lock_init (&frame_lock);
+	cond_init (&frame_io_done);
+	clock_hand = NULL;
+	if (!hash_init (&file_index, index_hash, index_less, NULL))
+		PANIC ("cannot allocate file page index");
+	page_cache = kmem_cache_create ("page", sizeof (struct page), NULL);
+	frame_cache = kmem_cache_create ("frame", sizeof (struct frame),
+			frame_ctor);
+	vm_uninit_init ();
+
+	zero_frame->kva = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+	list_init (&zero_frame->pages);
+	zero_frame->ref_cnt = 0;
+	zero_frame->pin_cnt = 1;
+
+	sema_init (&kswapd_sema, 0);
+	kswapd_awake = false;
+	sema_init (&flusher_sema, 0);
+	flusher_awake = false;
+	if (vm_wmark_low > 0)
+		thread_create ("kswapd", PRI_DEFAULT, kswapd, NULL);
+	if (vm_flush_age > 0)
+		thread_create ("flusher", PRI_DEFAULT, flusher, NULL);
+}
+
+/* Prints virtual memory statistics. */
+void
+vm_print_stats (void) {
+	printf ("Fault-around: %lld pages prefetched, %lld swap pages read "
+			"ahead, %lld faults saved, %lld wasted\n", fa_prefetch_cnt,
+			sra_prefetch_cnt, fa_saved_cnt, fa_wasted_cnt);
+	printf ("Reclaim: %lld frames allocated, %lld by direct reclaim; "
+			"kswapd woke %lld times, freed %lld frames\n",
+			frame_alloc_cnt, direct_cnt, kswapd_wake_cnt, kswapd_free_cnt);
+	printf ("File page index: %lld faults mapped a frame already "
+			"holding the page\n", file_share_cnt);
+	printf ("Flusher: %lld aged dirty pages written back\n", flush_cnt);
+	file_print_stats ();
+	zswap_print_stats ();
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -41,6 +174,27 @@ page_get_type (struct page *page) {
 static struct frame *vm_get_victim (void);
 static bool vm_do_claim_page (struct page *page);
 static struct frame *vm_evict_frame (void);
+static void frame_table_remove (struct frame *frame);
+static void frame_attach (struct frame *frame, struct page *page);
+static void frame_detach (struct page *page);
+static void frame_wait (struct page *page);
+static void frame_wait_idle (struct page *page);
+static bool page_is_zero_fill (struct page *page);
+static void page_zero_fill_init (struct page *page);
+static bool vm_map_zero_page (struct page *page);
+static bool page_is_lazy_file (struct page *page);
+static int readahead_window (struct vma *vma, int window);
+static void vm_fault_around_from (struct page *page, int window);
+static void vm_swap_readahead_from (struct page *page, size_t slot,
+		int window);
+static void vm_drop_behind (struct page *page);
+static void vm_discard_page (struct supplemental_page_table *spt,
+		struct page *page);
+static struct frame *index_find (const struct file_key *key);
+static void index_remove (struct frame *frame);
+static bool vm_map_indexed (struct page *page, const struct file_key *key);
+static bool vm_index_frame (struct page *page, const struct file_key *key);
+static void prefetch_settle (struct page *page, bool accessed);
 
 /* Hash table Helpers*/
 static uint64_t page_hash(const struct hash_elem *p_, void *aux UNUSED);
@@ -63,7 +217,7 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable,
 	ASSERT (VM_TYPE(type) != VM_UNINIT);
 
 	if (spt_find_page (spt, upage) == NULL) {
-		page = (struct page *)malloc(sizeof(struct page));
+		page = kmem_cache_alloc(page_cache);
 		if(page == NULL) goto err;
 
 		switch (VM_TYPE(type)){
@@ -79,13 +233,14 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable,
 
 		uninit_new(page, upage, init, type, aux, type_initializer);
 		page->writable = writable;
+		page->owner = thread_current ();
 
 		if(!(spt_insert_page(spt, page))) goto err;
 
 		return true;
 	}
 err:
-	if(page) free(page);
+	if(page) kmem_cache_free(page_cache, page);
 	return false;
 }
 
@@ -126,47 +281,207 @@ spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
 	return;
 }
 
-/* Get the struct frame, that will be evicted. */
+/* Advances the clock hand by one frame, wrapping around. */
+static struct list_elem *
+clock_next (struct list_elem *e) {
+	e = list_next (e);
+	return e != list_end (&frame_table) ? e : list_begin (&frame_table);
+}
+
+/* Get the struct frame, that will be evicted.
+ * Second chance: sweeps the clock hand over the frame table,
+ * clearing the accessed bit of recently used pages, and picks
+ * the first unpinned frame whose page was not accessed since the
+ * hand last passed.  Two sweeps always find one unless every
+ * frame is pinned.  FRAME_LOCK must be held. */
 static struct frame *
 vm_get_victim (void) {
-	struct frame *victim = NULL;
-	 /* TODO: The policy for eviction is up to you. */
+	size_t n;
 
-	return victim;
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	if (list_empty (&frame_table))
+		return NULL;
+	if (clock_hand == NULL)
+		clock_hand = list_begin (&frame_table);
+
+	for (n = 2 * list_size (&frame_table); n > 0; n--) {
+		struct frame *frame = list_entry (clock_hand, struct frame, elem);
+		bool accessed = false;
+		struct list_elem *e;
+
+		clock_hand = clock_next (clock_hand);
+		if (frame->pin_cnt > 0 || frame->ref_cnt == 0)
+			continue;
+
+		/* A shared frame is recently used if any sharer used it. */
+		for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+				e = list_next (e)) {
+			struct page *page = list_entry (e, struct page, frame_elem);
+			if (pml4_is_accessed (page->owner->pml4, page->va)) {
+				prefetch_settle (page, true);
+				pml4_set_accessed (page->owner->pml4, page->va, false);
+				accessed = true;
+			}
+		}
+		if (!accessed)
+			return frame;
+	}
+	return NULL;
 }
 
-/* Evict one page and return the corresponding frame.
- * Return NULL on error.*/
+/* Evicts a frame and returns it, mapped by no page, pinned and
+ * still in the frame table.  Returns NULL if nothing could be
+ * evicted.  FRAME_LOCK must be held.  It is dropped while the
+ * victim is written out, so that faults on other pages are not
+ * held up by the write, and held again on return. */
 static struct frame *
 vm_evict_frame (void) {
-	struct frame *victim UNUSED = vm_get_victim ();
-	/* TODO: swap out the victim and return the evicted frame. */
+	struct frame *victim = vm_get_victim ();
+	struct list_elem *e;
+	bool success;
 
-	return NULL;
+	if (victim == NULL)
+		return NULL;
+
+	/* The clock just found every sharer unaccessed. */
+	for (e = list_begin (&victim->pages); e != list_end (&victim->pages);
+			e = list_next (e))
+		prefetch_settle (list_entry (e, struct page, frame_elem), false);
+
+	/* Pinned, no other evictor picks it; marked, no one maps, pins
+	 * or frees it until it is done.  swap_out() unmaps every page
+	 * sharing the frame and saves the contents. */
+	victim->pin_cnt = 1;
+	victim->evicting = true;
+	lock_release (&frame_lock);
+	success = swap_out (frame_page (victim));
+	lock_acquire (&frame_lock);
+	victim->evicting = false;
+	cond_broadcast (&frame_io_done, &frame_lock);
+	if (!success) {
+		victim->pin_cnt = 0;
+		return NULL;
+	}
+
+	index_remove (victim);
+	while (!list_empty (&victim->pages))
+		frame_detach (frame_page (victim));
+	return victim;
+}
+
+/* Waits until PAGE is not on a frame being evicted, after which it
+ * has no frame.  FRAME_LOCK must be held. */
+static void
+frame_wait (struct page *page) {
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	while (page->frame != NULL && page->frame->evicting)
+		cond_wait (&frame_io_done, &frame_lock);
+}
+
+/* Waits until PAGE is not on a frame being evicted or written back
+ * by the flusher.  Needed before the frame may be freed or pinned
+ * for write-back.  FRAME_LOCK must be held. */
+static void
+frame_wait_idle (struct page *page) {
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	while (page->frame != NULL
+			&& (page->frame->evicting || page->frame->flushing))
+		cond_wait (&frame_io_done, &frame_lock);
+}
+
+/* Wakes the reclaim daemon if free user frames are below the low
+ * watermark and it is not already running.  FRAME_LOCK must be
+ * held. */
+static void
+kswapd_poke (void) {
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	if (vm_wmark_low == 0 || kswapd_awake
+			|| palloc_free_cnt (PAL_USER) >= vm_wmark_low)
+		return;
+	kswapd_awake = true;
+	kswapd_wake_cnt++;
+	sema_up (&kswapd_sema);
+}
+
+/* Reclaim daemon: each time it is woken, evicts frames one at a
+ * time until the high watermark is reached or nothing more can be
+ * evicted.  frame_lock is not held across the writes, so faults
+ * meanwhile are not held up. */
+static void
+kswapd (void *aux UNUSED) {
+	for (;;) {
+		sema_down (&kswapd_sema);
+		for (;;) {
+			struct frame *frame;
+
+			lock_acquire (&frame_lock);
+			if (palloc_free_cnt (PAL_USER) >= vm_wmark_high
+					|| (frame = vm_evict_frame ()) == NULL) {
+				kswapd_awake = false;
+				lock_release (&frame_lock);
+				break;
+			}
+			frame_table_remove (frame);
+			kswapd_free_cnt++;
+			lock_release (&frame_lock);
+
+			palloc_free_page (frame->kva);
+			kmem_cache_free (frame_cache, frame);
+		}
+	}
 }
 
 /* palloc() and get frame. If there is no available page, evict the page
  * and return it. This always return valid address. That is, if the user pool
  * memory is full, this function evicts the frame to get the available memory
- * space.*/
+ * space.  The frame is returned pinned. */
 static struct frame *
 vm_get_frame (void) {
 	struct frame	*frame = NULL;
-	void			*user_new_page = palloc_get_page(PAL_USER);
+	void			*user_new_page;
 
-	if(!user_new_page) PANIC("TODO Implement Frame Table");
-	
-	frame = (struct frame *)malloc(sizeof(struct frame));
-	if(!frame){
-		palloc_free_page(user_new_page);
-		return NULL;
-	}
+	user_new_page = palloc_get_page (PAL_USER);
+	if (user_new_page != NULL) {
+		frame = kmem_cache_alloc (frame_cache);
+		if (!frame) {
+			palloc_free_page (user_new_page);
+			return NULL;
+		}
+		frame->kva = user_new_page;
 
-	frame->kva = user_new_page;
-	frame->page = NULL;
+		/* Newest frames go just behind the hand, so they are the
+		 * last to be considered. */
+		lock_acquire (&frame_lock);
+		if (clock_hand != NULL)
+			list_insert (clock_hand, &frame->elem);
+		else
+			list_push_back (&frame_table, &frame->elem);
+	} else {
+		/* Direct reclaim: the daemon has fallen behind. */
+		lock_acquire (&frame_lock);
+		direct_cnt++;
+		frame = vm_evict_frame ();
+		if (frame == NULL) {
+			lock_release (&frame_lock);
+			return NULL;
+		}
+	}
+	frame->pin_cnt = 1;
+	frame->evicting = false;
+	frame->flushing = false;
+	frame->inode = NULL;
+	frame->dirty = false;
+	frame->flush_at = 0;
+	frame_alloc_cnt++;
+	kswapd_poke ();
+	lock_release (&frame_lock);
 
 	ASSERT (frame != NULL);
-	ASSERT (frame->page == NULL);
+	ASSERT (frame->ref_cnt == 0);
 	
 	return frame;
 }
@@ -176,15 +491,85 @@ static void
 vm_stack_growth (void *addr) {
 	uintptr_t pg_align_addr = (uintptr_t)pg_round_down(addr);
 	while(pg_align_addr < (uintptr_t) USER_STACK){
+		if(vma_find(&thread_current()->spt, (void *) pg_align_addr))
+			break;
 		if(!vm_alloc_page(VM_ANON | VM_MARKER_STACK, pg_align_addr, true))
 			break;
 		pg_align_addr += PGSIZE;
 	}
 }
 
-/* Handle the fault on write_protected page */
+/* Handle the fault on write_protected page.
+ * PAGE is writable but mapped read-only because its frame was
+ * shared at fork, or because it is mapped to the zero frame.  The
+ * last page left on a shared frame takes it over; any other gets
+ * a private copy, or a fresh zeroed frame in place of the zero
+ * frame. */
 static bool
-vm_handle_wp (struct page *page UNUSED) {
+vm_handle_wp (struct page *page) {
+	uint64_t *pml4 = page->owner->pml4;
+	struct frame *old, *new;
+
+	lock_acquire (&frame_lock);
+	frame_wait (page);
+	old = page->frame;
+	if (old == NULL) {
+		/* Evicted since the fault; the copy happened on swap-in. */
+		lock_release (&frame_lock);
+		return vm_do_claim_page (page);
+	}
+	if (old->inode != NULL) {
+		/* A file page frame is shared by design, not copied.  It
+		 * is mapped read-only until written so the flusher learns
+		 * it is dirty. */
+		frame_dirtied (old);
+		pml4_set_writable (pml4, page->va, true);
+		lock_release (&frame_lock);
+		return true;
+	}
+	if (old->ref_cnt == 1 && old != zero_frame) {
+		pml4_set_writable (pml4, page->va, true);
+		lock_release (&frame_lock);
+		return true;
+	}
+	old->pin_cnt++;
+	lock_release (&frame_lock);
+
+	new = vm_get_frame ();
+	if (new != NULL && old != zero_frame)
+		memcpy (new->kva, old->kva, PGSIZE);
+	else if (new != NULL)
+		memset (new->kva, 0, PGSIZE);
+
+	lock_acquire (&frame_lock);
+	old->pin_cnt--;
+	if (new == NULL) {
+		lock_release (&frame_lock);
+		return false;
+	}
+	frame_detach (page);
+	frame_attach (new, page);
+	pml4_clear_page (pml4, page->va);
+	if (!pml4_set_page (pml4, page->va, new->kva, true)) {
+		frame_detach (page);
+		frame_table_remove (new);
+		lock_release (&frame_lock);
+		palloc_free_page (new->kva);
+		kmem_cache_free (frame_cache, new);
+		return false;
+	}
+	new->pin_cnt = 0;
+
+	/* The other sharers may all have gone while we copied. */
+	if (old->ref_cnt == 0 && old != zero_frame) {
+		frame_table_remove (old);
+		lock_release (&frame_lock);
+		palloc_free_page (old->kva);
+		kmem_cache_free (frame_cache, old);
+		return true;
+	}
+	lock_release (&frame_lock);
+	return true;
 }
 
 /* Return true on success */
@@ -198,18 +583,234 @@ vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 	uintptr_t user_rsp = user ? (f->rsp):(thread_current()->rsp);
 
 	page = spt_find_page(spt, addr);
+	if(page == NULL){
+		/* Pages of an area are created on their first fault. */
+		struct vma *vma = vma_find(spt, addr);
+		if(vma && (page = vma_page_create(vma, addr)) == NULL)
+			return false;
+	}
 	if(page){
 		if(write && (!page->writable)) 
 			return false;
+		if(write && !not_present)
+			return vm_handle_wp(page);
+		if(!write && page_is_zero_fill(page))
+			return vm_map_zero_page(page);
 	} else {
 		if(is_valid_stack_access(user_rsp, addr)){
 			vm_stack_growth(addr);
 			page = spt_find_page(spt, addr); /* vm_stack_growth에서 SPT에 다시 등록했기 때문에, 다시 찾아야 함 */
+			if(page == NULL)
+				return false;
 		} else {
 			return false;
 		}
 	}
-	return vm_do_claim_page(page);
+
+	/* Memory mappings stay strictly demand-paged unless advised
+	 * otherwise or -fa was given: lazy-file expects an mmap'd page
+	 * to be loaded only once touched. */
+	struct vma *vma = page->vma;
+	int around = 1;
+	if(vma && page_is_lazy_file(page))
+		around = readahead_window(vma, VM_TYPE(vma->type) == VM_FILE
+				&& !vm_fault_around_mmap ? 1 : vm_fault_around);
+	size_t slot = anon_disk_slot(page);
+	if(!vm_do_claim_page(page))
+		return false;
+	if(around > 1)
+		vm_fault_around_from(page, around);
+	if(slot != SWAP_SLOT_NONE)
+		vm_swap_readahead_from(page, slot,
+				readahead_window(vma, vm_swap_readahead));
+	if(vma && vma->advice == MADV_SEQUENTIAL)
+		vm_drop_behind(page);
+	return true;
+}
+
+/* Applies ADVICE, one of the MADV_* values, to the LENGTH bytes
+ * at page-aligned ADDR in the current process.  Areas are never
+ * split, so MADV_NORMAL, MADV_RANDOM and MADV_SEQUENTIAL apply to
+ * each whole area the range touches; pages outside areas have no
+ * readahead to tune.  MADV_WILLNEED and MADV_DONTNEED act on just
+ * the pages of the range.  Returns false if ADDR is misaligned,
+ * ADVICE is unknown, or part of the range is not mapped. */
+bool
+vm_madvise (void *addr, size_t length, int advice) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	void *end = addr + ROUND_UP (length, PGSIZE);
+	void *va;
+
+	if (pg_ofs (addr) != 0 || end < addr
+			|| advice < MADV_NORMAL || advice > MADV_DONTNEED)
+		return false;
+	for (va = addr; va < end; va += PGSIZE)
+		if (spt_find_page (spt, va) == NULL && vma_find (spt, va) == NULL)
+			return false;
+
+	for (va = addr; va < end; va += PGSIZE) {
+		struct page *page = spt_find_page (spt, va);
+		struct vma *vma = page != NULL ? page->vma : vma_find (spt, va);
+
+		switch (advice) {
+			case MADV_WILLNEED:
+				/* Only a hint: stop quietly when memory runs out. */
+				if (page == NULL)
+					page = vma_page_create (vma, va);
+				if (page == NULL || !vm_do_claim_page (page))
+					return true;
+				break;
+			case MADV_DONTNEED:
+				if (page != NULL)
+					vm_discard_page (spt, page);
+				break;
+			default:
+				if (vma != NULL)
+					vma->advice = advice;
+				break;
+		}
+	}
+	return true;
+}
+
+/* Drops PAGE's contents for MADV_DONTNEED.  A page of an area is
+ * removed, after any write-back, and is created afresh from the
+ * area on its next fault; any other page is anonymous and reads
+ * back as zeros. */
+static void
+vm_discard_page (struct supplemental_page_table *spt, struct page *page) {
+	if (page->vma != NULL) {
+		vma_remove_page (page);
+		spt_remove_page (spt, page);
+	} else if (page->operations->type == VM_ANON)
+		anon_discard (page);
+}
+
+/* Returns the readahead window for a fault in VMA, which may be
+ * NULL, given the default WINDOW. */
+static int
+readahead_window (struct vma *vma, int window) {
+	if (vma == NULL)
+		return window;
+	switch (vma->advice) {
+		case MADV_RANDOM:
+			return 1;
+		case MADV_SEQUENTIAL:
+			return VM_FAULT_AROUND_MAX;
+		default:
+			return window;
+	}
+}
+
+/* Under MADV_SEQUENTIAL, the pages one readahead window or more
+ * behind PAGE, which was just faulted on, are not expected to be
+ * used again.  Clears their accessed bits so the clock takes them
+ * before pages still in use. */
+static void
+vm_drop_behind (struct page *page) {
+	struct supplemental_page_table *spt = &page->owner->spt;
+	uint64_t *pml4 = page->owner->pml4;
+	int i;
+
+	for (i = VM_FAULT_AROUND_MAX; i < 2 * VM_FAULT_AROUND_MAX; i++) {
+		void *va = page->va - i * PGSIZE;
+		struct page *p;
+
+		if (va > page->va || va < page->vma->start)
+			break;
+		p = spt_find_page (spt, va);
+		if (p == NULL)
+			continue;
+		lock_acquire (&frame_lock);
+		if (p->frame != NULL) {
+			prefetch_settle (p, pml4_is_accessed (pml4, va));
+			pml4_set_accessed (pml4, va, false);
+		}
+		lock_release (&frame_lock);
+	}
+}
+
+/* Returns true if PAGE is still waiting to be loaded from an
+ * executable or a memory-mapped file. */
+static bool
+page_is_lazy_file (struct page *page) {
+	struct uninit_aux *aux;
+
+	if (page->operations->type != VM_UNINIT || page->uninit.init == NULL)
+		return false;
+	aux = page->uninit.aux;
+	if (aux == NULL)
+		return false;
+	if (aux->type == UNINIT_AUX_LOAD)
+		return aux->aux_load.page_read_bytes > 0;
+	return aux->type == UNINIT_AUX_FILE;
+}
+
+/* Loads the pages of PAGE's area that follow PAGE, which was
+ * just faulted in from the file, so that sequential access does
+ * not trap on each of them.  Stops at the first page that was
+ * already created or has nothing to read from the file.  PAGE is
+ * pinned meanwhile so the prefetch cannot evict it. */
+static void
+vm_fault_around_from (struct page *page, int window) {
+	struct supplemental_page_table *spt = &page->owner->spt;
+	struct vma *vma = page->vma;
+	int i;
+
+	if (!vm_pin_page (page))
+		return;
+	for (i = 1; i < window; i++) {
+		void *va = page->va + i * PGSIZE;
+		struct page *next;
+
+		if (va >= vma->end || vma_page_read_bytes (vma, va) == 0
+				|| spt_find_page (spt, va) != NULL)
+			break;
+		next = vma_page_create (vma, va);
+		if (next == NULL || !vm_do_claim_page (next))
+			break;
+		next->prefetched = true;
+		fa_prefetch_cnt++;
+	}
+	vm_unpin_page (page);
+}
+
+/* Swaps in the pages following PAGE, which was just read from
+ * swap slot SLOT, up to WINDOW pages in all, for as long as they
+ * are in the slots following it, so that a sweep over swapped-out memory reads the disk
+ * sequentially instead of a page per fault.  Only uses free
+ * frames: reading ahead is not worth evicting for. */
+static void
+vm_swap_readahead_from (struct page *page, size_t slot, int window) {
+	struct supplemental_page_table *spt = &page->owner->spt;
+	int i;
+
+	if (window <= 1 || !vm_pin_page (page))
+		return;
+	for (i = 1; i < window; i++) {
+		struct page *next = spt_find_page (spt, page->va + i * PGSIZE);
+
+		if (next == NULL || anon_disk_slot (next) != slot + i
+				|| palloc_free_cnt (PAL_USER) == 0
+				|| !vm_do_claim_page (next))
+			break;
+		next->prefetched = true;
+		sra_prefetch_cnt++;
+	}
+	vm_unpin_page (page);
+}
+
+/* Settles the fault-around accounting for PAGE, whose accessed
+ * bit was found to be ACCESSED. */
+static void
+prefetch_settle (struct page *page, bool accessed) {
+	if (!page->prefetched)
+		return;
+	page->prefetched = false;
+	if (accessed)
+		fa_saved_cnt++;
+	else
+		fa_wasted_cnt++;
 }
 
 static bool is_valid_stack_access(uintptr_t user_rsp, void *addr){
@@ -230,14 +831,167 @@ static bool is_valid_stack_access(uintptr_t user_rsp, void *addr){
 void
 vm_dealloc_page (struct page *page) {
 	destroy (page);
-	free (page);
+	kmem_cache_free (page_cache, page);
+}
+
+/* Unlinks FRAME from the frame table, moving the clock hand off
+ * it first.  FRAME_LOCK must be held. */
+static void
+frame_table_remove (struct frame *frame) {
+	index_remove (frame);
+	if (clock_hand == &frame->elem)
+		clock_hand = list_size (&frame_table) > 1 ? clock_next (clock_hand) : NULL;
+	list_remove (&frame->elem);
 }
 
 static void
 vm_dealloc_frame(struct frame *frame){
+	lock_acquire (&frame_lock);
+	frame_table_remove (frame);
+	lock_release (&frame_lock);
 	palloc_free_page(frame -> kva);
-	//list_remove(&frame->elem); // TODO: 프레임 리스트 구현 시 주석 해제(아직 구현 안됨)
-	free(frame);
+	kmem_cache_free(frame_cache, frame);
+}
+
+/* Unmaps PAGE and releases the frame holding it, if any.  Used by
+ * the page types' destroy operations, after any write-back. */
+void
+vm_free_frame (struct page *page) {
+	struct frame *frame;
+
+	lock_acquire (&frame_lock);
+	frame_wait_idle (page);
+	frame = page->frame;
+	if (frame == NULL) {
+		lock_release (&frame_lock);
+		return;
+	}
+	if (page->owner->pml4 != NULL) {
+		prefetch_settle (page,
+				pml4_is_accessed (page->owner->pml4, page->va));
+		pml4_clear_page (page->owner->pml4, page->va);
+	}
+	frame_detach (page);
+	if (frame->ref_cnt > 0 || frame == zero_frame) {
+		/* Still mapped by other sharers. */
+		lock_release (&frame_lock);
+		return;
+	}
+	frame_table_remove (frame);
+	lock_release (&frame_lock);
+
+	palloc_free_page (frame->kva);
+	kmem_cache_free (frame_cache, frame);
+}
+
+/* Maps DST onto the frame holding SRC, read-only in both, so the
+ * two share it until one of them writes.  Returns false, sharing
+ * nothing, if SRC is not resident. */
+bool
+vm_share_frame (struct page *dst, struct page *src) {
+	struct frame *frame;
+
+	lock_acquire (&frame_lock);
+	frame_wait (src);
+	frame = src->frame;
+	if (frame == NULL) {
+		lock_release (&frame_lock);
+		return false;
+	}
+	if (frame->inode != NULL) {
+		/* A file page frame is shared by all mappings, writable
+		 * after a write fault; see vm_handle_wp(). */
+		if (!pml4_set_page (dst->owner->pml4, dst->va, frame->kva, false)) {
+			lock_release (&frame_lock);
+			return false;
+		}
+		frame_attach (frame, dst);
+		lock_release (&frame_lock);
+		return true;
+	}
+	if (!pml4_set_page (dst->owner->pml4, dst->va, frame->kva, false)) {
+		lock_release (&frame_lock);
+		return false;
+	}
+	pml4_set_writable (src->owner->pml4, src->va, false);
+	frame_attach (frame, dst);
+	lock_release (&frame_lock);
+	return true;
+}
+
+/* Returns true if PAGE has never been touched and would be
+ * filled entirely with zeros: a pending stack page, or a BSS page
+ * of an executable segment with nothing to read from the file. */
+static bool
+page_is_zero_fill (struct page *page) {
+	struct uninit_aux *aux;
+
+	if (page->operations->type != VM_UNINIT
+			|| VM_TYPE (page->uninit.type) != VM_ANON)
+		return false;
+	if (page->uninit.init == NULL)
+		return true;
+	aux = page->uninit.aux;
+	return aux != NULL && aux->type == UNINIT_AUX_LOAD
+		&& aux->aux_load.page_read_bytes == 0;
+}
+
+/* Turns PAGE, for which page_is_zero_fill() is true, into an
+ * anonymous page without a frame or swap slot.  Such a page is
+ * zeroed by anon swap-in when it is finally claimed. */
+static void
+page_zero_fill_init (struct page *page) {
+	struct uninit_page *uninit = &page->uninit;
+	void *aux = uninit->aux;
+
+	uninit->page_initializer (page, uninit->type, NULL);
+	uninit_aux_free (aux);
+}
+
+/* Handles a read fault on a zero-fill PAGE by mapping the shared
+ * zero frame read-only.  The first write replaces it with a
+ * private frame in vm_handle_wp(). */
+static bool
+vm_map_zero_page (struct page *page) {
+	bool success;
+
+	page_zero_fill_init (page);
+
+	lock_acquire (&frame_lock);
+	success = pml4_set_page (page->owner->pml4, page->va, zero_frame->kva,
+			false);
+	if (success)
+		frame_attach (zero_frame, page);
+	lock_release (&frame_lock);
+	return success;
+}
+
+/* Constructs a frame as the frame cache hands it out: mapped by
+ * no page.  Frames are freed only once their last page is gone. */
+static void
+frame_ctor (void *frame_) {
+	struct frame *frame = frame_;
+
+	list_init (&frame->pages);
+	frame->ref_cnt = 0;
+}
+
+/* Records that PAGE is mapped by FRAME. */
+static void
+frame_attach (struct frame *frame, struct page *page) {
+	list_push_back (&frame->pages, &page->frame_elem);
+	frame->ref_cnt++;
+	page->frame = frame;
+}
+
+/* Removes PAGE from the pages mapping its frame. */
+static void
+frame_detach (struct page *page) {
+	struct frame *frame = page->frame;
+
+	list_remove (&page->frame_elem);
+	frame->ref_cnt--;
+	page->frame = NULL;
 }
 
 
@@ -254,29 +1008,442 @@ vm_claim_page (void *va) {
 /* Claim the PAGE and set up the mmu. */
 static bool
 vm_do_claim_page (struct page *page) {
-	struct frame *frame = vm_get_frame ();
-	struct thread *t = thread_current();
+	struct frame *frame;
+	uint64_t *pml4;
+
+	struct file_key key;
+	bool indexed, resident;
+
+	if(!page) return false;
+	lock_acquire (&frame_lock);
+	frame_wait (page);
+	resident = page->frame != NULL;
+	lock_release (&frame_lock);
+	if(resident) return true;
+	if(page_is_zero_fill(page))
+		page_zero_fill_init(page);
+
+	indexed = file_page_key(page, &key);
+	if(indexed && vm_map_indexed(page, &key))
+		return true;
 
-	if(!frame || !page) return false;
+	frame = vm_get_frame ();
+	if(!frame) return false;
+	pml4 = page->owner->pml4;
 
 	/* Set links */
-	frame->page = page;
-	page->frame = frame;
+	frame_attach (frame, page);
 
-	if(!pml4_set_page(t->pml4, page->va, frame->kva, page->writable)){
+	/* A file page is mapped read-only until its first write. */
+	if(!pml4_set_page(pml4, page->va, frame->kva, page->writable && !indexed)){
+		frame_detach (page);
 		vm_dealloc_frame(frame);
 		return false;
 	}
 	
 	if(false == swap_in(page, frame->kva)){
-		pml4_clear_page(t->pml4, page->va);
+		pml4_clear_page(pml4, page->va);
+		frame_detach (page);
 		vm_dealloc_frame(frame);
 		return false; 
 	}
 
+	if(indexed)
+		return vm_index_frame(page, &key);
+
+	/* Fully loaded; the clock may now consider it. */
+	lock_acquire (&frame_lock);
+	frame->pin_cnt--;
+	lock_release (&frame_lock);
+	return true;
+}
+
+/* Maps PAGE, identified by KEY, onto the frame that already holds
+ * its file page for another mapping, if there is one.  Returns
+ * true if it did. */
+static bool
+vm_map_indexed (struct page *page, const struct file_key *key) {
+	struct frame *frame;
+
+	lock_acquire (&frame_lock);
+	frame = index_find (key);
+	while (frame != NULL && frame->evicting) {
+		/* Its write-back must land before the page is read again. */
+		cond_wait (&frame_io_done, &frame_lock);
+		frame = index_find (key);
+	}
+	if (frame == NULL
+			|| !pml4_set_page (page->owner->pml4, page->va, frame->kva,
+				false)) {
+		lock_release (&frame_lock);
+		return false;
+	}
+	file_page_adopt (page);
+	frame_attach (frame, page);
+	file_share_cnt++;
+	lock_release (&frame_lock);
+	return true;
+}
+
+/* Enters PAGE's frame, just loaded and still pinned, in the file
+ * page index under KEY, and unpins it.  If another mapping loaded
+ * the same page meanwhile, PAGE moves to that frame instead and
+ * its own is freed.  Returns false if PAGE could not be mapped. */
+static bool
+vm_index_frame (struct page *page, const struct file_key *key) {
+	struct frame *frame = page->frame;
+	struct frame *other;
+	bool success;
+
+	lock_acquire (&frame_lock);
+	other = index_find (key);
+	while (other != NULL && other->evicting) {
+		cond_wait (&frame_io_done, &frame_lock);
+		other = index_find (key);
+	}
+	if (other == NULL) {
+		frame->inode = key->inode;
+		frame->pos = key->pos;
+		hash_insert (&file_index, &frame->index_elem);
+		frame->pin_cnt--;
+		lock_release (&frame_lock);
+		return true;
+	}
+
+	pml4_clear_page (page->owner->pml4, page->va);
+	frame_detach (page);
+	frame_table_remove (frame);
+	success = pml4_set_page (page->owner->pml4, page->va, other->kva,
+			false);
+	if (success) {
+		frame_attach (other, page);
+		file_share_cnt++;
+	}
+	lock_release (&frame_lock);
+	palloc_free_page (frame->kva);
+	kmem_cache_free (frame_cache, frame);
+	return success;
+}
+
+/* Returns the indexed frame holding the file page KEY, or NULL.
+ * A frame loaded for a mapping that reads a different number of
+ * bytes of the page holds different contents and is not used.
+ * FRAME_LOCK must be held. */
+static struct frame *
+index_find (const struct file_key *key) {
+	struct frame dummy;
+	struct hash_elem *e;
+	struct frame *frame;
+
+	dummy.inode = key->inode;
+	dummy.pos = key->pos;
+	e = hash_find (&file_index, &dummy.index_elem);
+	if (e == NULL)
+		return NULL;
+	frame = hash_entry (e, struct frame, index_elem);
+	if (frame_page (frame)->file.read_bytes != key->read_bytes)
+		return NULL;
+	return frame;
+}
+
+/* Removes FRAME from the file page index, if it is there.
+ * FRAME_LOCK must be held. */
+static void
+index_remove (struct frame *frame) {
+	if (frame->inode == NULL)
+		return;
+	hash_delete (&file_index, &frame->index_elem);
+	frame->inode = NULL;
+}
+
+static uint64_t
+index_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct frame *f = hash_entry (e, struct frame, index_elem);
+	return hash_bytes (&f->inode, sizeof f->inode) ^ hash_int (f->pos);
+}
+
+static bool
+index_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct frame *a = hash_entry (a_, struct frame, index_elem);
+	const struct frame *b = hash_entry (b_, struct frame, index_elem);
+
+	if (a->inode != b->inode)
+		return a->inode < b->inode;
+	return a->pos < b->pos;
+}
+
+/* Collects the dirty state of the frame that PAGE, whose mapping
+ * is going away, has pinned.  If other pages still share the
+ * frame, PAGE's dirty bit is kept in the frame for the last of
+ * them to write back, PAGE is unmapped and leaves the frame, and
+ * false is returned.  Otherwise PAGE stays, and true is returned
+ * if the frame must be written back. */
+bool
+vm_frame_take_dirty (struct page *page) {
+	struct frame *frame;
+	bool dirty;
+
+	lock_acquire (&frame_lock);
+	frame = page->frame;
+	ASSERT (frame != NULL && frame->pin_cnt > 0);
+	dirty = frame->dirty || pml4_is_dirty (page->owner->pml4, page->va);
+	if (frame->ref_cnt == 1) {
+		frame->dirty = false;
+		lock_release (&frame_lock);
+		return dirty;
+	}
+	frame->dirty = dirty;
+	prefetch_settle (page, pml4_is_accessed (page->owner->pml4, page->va));
+	pml4_clear_page (page->owner->pml4, page->va);
+	frame_detach (page);
+	frame->pin_cnt--;
+	lock_release (&frame_lock);
+	return false;
+}
+
+/* Takes the dirty state of PAGE, whose frame the caller pinned,
+ * leaving the frame clean in every page sharing it, so the caller
+ * can write it back now.  A write after this dirties it again. */
+bool
+vm_frame_clean (struct page *page) {
+	bool dirty;
+
+	lock_acquire (&frame_lock);
+	ASSERT (page->frame != NULL && page->frame->pin_cnt > 0);
+	dirty = frame_clean (page->frame);
+	lock_release (&frame_lock);
+	return dirty;
+}
+
+/* Clears the dirty state of FRAME in every page sharing it and
+ * returns what it was.  The pages are write-protected again, so
+ * the next write goes through vm_handle_wp() and restarts the
+ * flusher's clock.  FRAME_LOCK must be held. */
+static bool
+frame_clean (struct frame *frame) {
+	bool dirty = frame->dirty;
+	struct list_elem *e;
+
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *p = list_entry (e, struct page, frame_elem);
+		if (pml4_is_dirty (p->owner->pml4, p->va)) {
+			dirty = true;
+			pml4_set_dirty (p->owner->pml4, p->va, false);
+		}
+		pml4_set_writable (p->owner->pml4, p->va, false);
+	}
+	frame->dirty = false;
+	frame->flush_at = 0;
+	return dirty;
+}
+
+/* Wakes the flusher, or has it make another pass if it is already
+ * awake.  FRAME_LOCK must be held. */
+static void
+flusher_wake (void) {
+	if (!flusher_awake) {
+		flusher_awake = true;
+		sema_up (&flusher_sema);
+	} else
+		flush_again = true;
+}
+
+/* Starts the flusher's clock on FRAME, a file page frame that a
+ * mapping is about to write, unless it is running already.
+ * FRAME_LOCK must be held. */
+static void
+frame_dirtied (struct frame *frame) {
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	if (vm_flush_age == 0 || frame->flush_at != 0)
+		return;
+	frame->flush_at = timer_ticks () + vm_flush_age * TIMER_FREQ / 1000;
+	flusher_wake ();
+}
+
+/* Makes one pass over the frame table, writing back the mapped file
+ * frames that are due, and returns true if any frame is left
+ * waiting.  One sweep cleans, pins and marks the due frames, up to
+ * FLUSH_BATCH of them in BATCH, which are then written sorted by
+ * file offset with FRAME_LOCK released.  The sweep resumes after
+ * the last frame of the batch, which stays in the table while it
+ * is marked. */
+static bool
+flush_pass (struct page **batch) {
+	int64_t now = timer_ticks ();
+	bool pending = false;
+	struct list_elem *e;
+
+	lock_acquire (&frame_lock);
+	flush_again = false;
+	e = list_begin (&frame_table);
+	while (e != list_end (&frame_table)) {
+		struct frame *last = NULL;
+		size_t cnt = 0, i;
+
+		for (; e != list_end (&frame_table) && cnt < FLUSH_BATCH;
+				e = list_next (e)) {
+			struct frame *frame = list_entry (e, struct frame, elem);
+
+			if (frame->flush_at == 0 || frame->ref_cnt == 0)
+				continue;
+			if (frame->pin_cnt > 0 || frame->flush_at > now) {
+				pending = true;
+				continue;
+			}
+			if (frame_clean (frame)) {
+				frame->pin_cnt++;
+				frame->flushing = true;
+				batch[cnt++] = frame_page (frame);
+				last = frame;
+			}
+		}
+		if (cnt == 0)
+			break;
+
+		lock_release (&frame_lock);
+		file_writeback_pages (batch, cnt);
+		lock_acquire (&frame_lock);
+
+		e = list_next (&last->elem);
+		for (i = 0; i < cnt; i++) {
+			batch[i]->frame->flushing = false;
+			batch[i]->frame->pin_cnt--;
+		}
+		flush_cnt += cnt;
+		cond_broadcast (&frame_io_done, &frame_lock);
+	}
+
+	/* Frames dirtied behind the sweep are caught on the next pass;
+	 * with none left, sleep until frame_dirtied(). */
+	pending |= flush_again;
+	if (!pending)
+		flusher_awake = false;
+	lock_release (&frame_lock);
+	return pending;
+}
+
+/* Flusher: once a write through a file mapping wakes it, writes
+ * back every vm_flush_period milliseconds the mapped file pages
+ * that have stayed dirty for vm_flush_age milliseconds, so that a
+ * process writing through a mapping does not pile up dirty data
+ * until it unmaps it or exits.  It sleeps again once none are. */
+static void
+flusher (void *aux UNUSED) {
+	struct page **batch = palloc_get_page (PAL_ASSERT);
+
+	for (;;) {
+		sema_down (&flusher_sema);
+		do
+			timer_msleep (vm_flush_period);
+		while (flush_pass (batch));
+	}
+}
+
+/* Makes the dirty pages of VMA in [START, END) due for write-back,
+ * for MS_ASYNC.  The flusher writes them on its next pass. */
+static void
+flush_soon (struct vma *vma, void *start, void *end) {
+	struct list_elem *e;
+
+	lock_acquire (&frame_lock);
+	for (e = list_begin (&vma->pages); e != list_end (&vma->pages);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, vma_elem);
+		if (page->va >= start && page->va < end && page->frame != NULL
+				&& page->frame->inode != NULL) {
+			page->frame->flush_at = 1;
+			flusher_wake ();
+		}
+	}
+	lock_release (&frame_lock);
+}
+
+/* Writes back the dirty pages of memory mappings among the LENGTH
+ * bytes at page-aligned ADDR.  With MS_SYNC they are written before
+ * returning; with MS_ASYNC they are only made due, for the flusher
+ * to write on its next pass, or at once if the flusher is disabled.
+ * MS_INVALIDATE has nothing to do, since all mappings of a file
+ * page share one frame.  Returns false if ADDR is misaligned, FLAGS
+ * are invalid, or part of the range is not a memory mapping. */
+bool
+vm_msync (void *addr, size_t length, int flags) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	void *end = addr + ROUND_UP (length, PGSIZE);
+	struct vma *vma;
+	void *va;
+
+	if (pg_ofs (addr) != 0 || end < addr
+			|| (flags & ~(MS_ASYNC | MS_INVALIDATE | MS_SYNC)) != 0
+			|| (flags & (MS_ASYNC | MS_SYNC)) == (MS_ASYNC | MS_SYNC))
+		return false;
+	for (va = addr; va < end; va = vma->end) {
+		vma = vma_find (spt, va);
+		if (vma == NULL || VM_TYPE (vma->type) != VM_FILE)
+			return false;
+	}
+
+	for (va = addr; va < end; va = vma->end) {
+		void *stop;
+
+		vma = vma_find (spt, va);
+		stop = end < vma->end ? end : vma->end;
+		if (flags & MS_SYNC || (flags & MS_ASYNC && vm_flush_age == 0))
+			file_writeback_area (vma, va, stop);
+		else if (flags & MS_ASYNC)
+			flush_soon (vma, va, stop);
+	}
 	return true;
 }
 
+/* Makes PAGE resident, if it is not already, and pins its frame
+ * so it cannot be evicted until vm_unpin_page().  Returns false
+ * if the page could not be brought in. */
+bool
+vm_pin_page (struct page *page) {
+	for (;;) {
+		lock_acquire (&frame_lock);
+		frame_wait_idle (page);
+		if (page->frame != NULL) {
+			page->frame->pin_cnt++;
+			lock_release (&frame_lock);
+			return true;
+		}
+		lock_release (&frame_lock);
+
+		/* May be evicted again before we pin it; just retry. */
+		if (!vm_do_claim_page (page))
+			return false;
+	}
+}
+
+/* Pins PAGE's frame if PAGE is resident, without bringing it in
+ * otherwise.  Returns true if the frame was pinned. */
+bool
+vm_pin_page_if_resident (struct page *page) {
+	bool pinned = false;
+
+	lock_acquire (&frame_lock);
+	frame_wait_idle (page);
+	if (page->frame != NULL) {
+		page->frame->pin_cnt++;
+		pinned = true;
+	}
+	lock_release (&frame_lock);
+	return pinned;
+}
+
+/* Lets the clock evict PAGE's frame again. */
+void
+vm_unpin_page (struct page *page) {
+	lock_acquire (&frame_lock);
+	if (page->frame != NULL)
+		page->frame->pin_cnt--;
+	lock_release (&frame_lock);
+}
+
 /* Initialize new supplemental page table */
 void
 supplemental_page_table_init (struct supplemental_page_table *spt) {
@@ -284,6 +1451,8 @@ supplemental_page_table_init (struct supplemental_page_table *spt) {
 	/* 해시 함수로 다시 구현 */
 	if(!hash_init(&spt->hs_table, page_hash, page_less, NULL))
 		PANIC("spt initialize failed");
+	list_init(&spt->vmas);
+	spt->swap_next = SWAP_SLOT_NONE;
 }
 
 /* Copy supplemental page table from src to dst */
@@ -294,12 +1463,20 @@ supplemental_page_table_copy (struct supplemental_page_table *dst,
 	struct hash_elem		*src_e;
 	struct page				*src_page;
 
+	if (!vma_copy_all(dst, src))
+		return false;
+
 	hash_first(&src_i, &(src->hs_table));
 	while (hash_next(&src_i))
 	{
 		src_e = hash_cur(&src_i);
 		src_page = hash_entry(src_e, struct page, hs_elem);
 
+		/* Pages of an area that were never loaded are created
+		 * again from the child's copy of the area. */
+		if (src_page->vma && src_page->operations->type == VM_UNINIT)
+			continue;
+
 		switch (src_page->operations->type) {
 			case VM_UNINIT:
 				if (false == uninit_copy(dst, src_page)) 
@@ -314,8 +1491,15 @@ supplemental_page_table_copy (struct supplemental_page_table *dst,
 				}
 				break ;
 			case VM_FILE:
+				if (false == file_copy(dst, src_page))
+				{
+					return false;
+				}
 				break ;
 		}
+		if (src_page->vma)
+			vma_add_page(vma_find(dst, src_page->va),
+					spt_find_page(dst, src_page->va));
 	}
 	return true;
 }
@@ -323,9 +1507,17 @@ supplemental_page_table_copy (struct supplemental_page_table *dst,
 /* Free the resource hold by the supplemental page table */
 void
 supplemental_page_table_kill (struct supplemental_page_table *spt) {
-	/* TODO: Destroy all the supplemental_page_table hold by thread and
-	 * TODO: writeback all the modified contents to the storage. */
+	struct list_elem *e;
+
+	/* Write back each mapping in file order before its pages go. */
+	for (e = list_begin (&spt->vmas); e != list_end (&spt->vmas);
+			e = list_next (e)) {
+		struct vma *vma = list_entry (e, struct vma, elem);
+		if (VM_TYPE (vma->type) == VM_FILE)
+			file_writeback_area (vma, vma->start, vma->end);
+	}
 	hash_destroy(&(spt->hs_table), page_destroy);
+	vma_destroy_all(spt);
 }
 
 
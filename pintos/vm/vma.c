@@ -0,0 +1,231 @@
+/* vma.c: Virtual memory areas.
+ *
+ * Memory mappings and executable segments are recorded as one
+ * area each, kept sorted by address in the supplemental page
+ * table.  Setting one up costs the same whatever its length: the
+ * struct page for each address is created from the area on the
+ * first fault there, and unmapping walks only the pages that were
+ * ever created. */
+
+#include "vm/vm.h"
+#include "vm/vma.h"
+#include <round.h>
+#include <syscall-nr.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+
+static bool vma_less (const struct list_elem *a, const struct list_elem *b,
+		void *aux);
+static bool vma_range_is_free (struct supplemental_page_table *spt,
+		void *start, void *end);
+
+/* Records an area of LENGTH bytes at page-aligned START in SPT,
+ * whose first READ_BYTES bytes are read from FILE at OFFSET and
+ * the rest zeroed.  Pages are of TYPE and are loaded by INIT.  The
+ * area gets its own handle on FILE.  Returns NULL if the range
+ * overlaps pages already in SPT or on allocation failure. */
+struct vma *
+vma_create (struct supplemental_page_table *spt, void *start, size_t length,
+		enum vm_type type, bool writable, struct file *file, off_t offset,
+		size_t read_bytes, vm_initializer *init) {
+	void *end = start + ROUND_UP (length, PGSIZE);
+	struct vma *vma;
+
+	ASSERT (pg_ofs (start) == 0);
+	ASSERT (read_bytes <= length);
+
+	if (length == 0 || end < start || !vma_range_is_free (spt, start, end))
+		return NULL;
+
+	vma = malloc (sizeof *vma);
+	if (vma == NULL)
+		return NULL;
+	vma->file = file_reopen (file);
+	if (vma->file == NULL) {
+		free (vma);
+		return NULL;
+	}
+	vma->start = start;
+	vma->end = end;
+	vma->type = type;
+	vma->writable = writable;
+	vma->offset = offset;
+	vma->read_bytes = read_bytes;
+	vma->init = init;
+	vma->advice = MADV_NORMAL;
+	list_init (&vma->pages);
+	list_insert_ordered (&spt->vmas, &vma->elem, vma_less, NULL);
+	return vma;
+}
+
+/* Returns the area of SPT containing VA, or NULL. */
+struct vma *
+vma_find (struct supplemental_page_table *spt, void *va) {
+	struct list_elem *e;
+
+	for (e = list_begin (&spt->vmas); e != list_end (&spt->vmas);
+			e = list_next (e)) {
+		struct vma *vma = list_entry (e, struct vma, elem);
+		if (va < vma->start)
+			break;
+		if (va < vma->end)
+			return vma;
+	}
+	return NULL;
+}
+
+/* Returns the number of bytes of the page at VA in VMA that are
+ * read from the file. */
+size_t
+vma_page_read_bytes (struct vma *vma, void *va) {
+	size_t ofs = pg_round_down (va) - vma->start;
+
+	if (ofs >= vma->read_bytes)
+		return 0;
+	return vma->read_bytes - ofs < PGSIZE ? vma->read_bytes - ofs : PGSIZE;
+}
+
+/* Creates the pending page for VA in VMA in the current thread's
+ * supplemental page table.  Returns the page, or NULL on
+ * allocation failure. */
+struct page *
+vma_page_create (struct vma *vma, void *va) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct uninit_aux *aux;
+	struct page *page;
+	void *upage = pg_round_down (va);
+	off_t pos = vma->offset + (upage - vma->start);
+	size_t read_bytes = vma_page_read_bytes (vma, upage);
+
+	aux = uninit_aux_alloc ();
+	if (aux == NULL)
+		return NULL;
+	if (VM_TYPE (vma->type) == VM_FILE)
+		*aux = (struct uninit_aux) {
+			.type = UNINIT_AUX_FILE,
+			.aux_file = (struct uninit_aux_file) {
+				.file = vma->file,
+				.page_pos = pos,
+				.page_read_bytes = read_bytes,
+				.page_zero_bytes = PGSIZE - read_bytes,
+				.mmap_base = vma->start,
+			}
+		};
+	else
+		*aux = (struct uninit_aux) {
+			.type = UNINIT_AUX_LOAD,
+			.aux_load = (struct uninit_aux_load) {
+				.elf_file = vma->file,
+				.page_pos = pos,
+				.page_read_bytes = read_bytes,
+				.page_zero_bytes = PGSIZE - read_bytes,
+			}
+		};
+
+	if (!vm_alloc_page_with_initializer (vma->type, upage, vma->writable,
+				vma->init, aux)) {
+		uninit_aux_free (aux);
+		return NULL;
+	}
+	page = spt_find_page (spt, upage);
+	vma_add_page (vma, page);
+	return page;
+}
+
+/* Records that PAGE was created in VMA. */
+void
+vma_add_page (struct vma *vma, struct page *page) {
+	page->vma = vma;
+	list_push_back (&vma->pages, &page->vma_elem);
+}
+
+/* Records that PAGE, created in an area, is about to be removed
+ * from it. */
+void
+vma_remove_page (struct page *page) {
+	ASSERT (page->vma != NULL);
+	list_remove (&page->vma_elem);
+	page->vma = NULL;
+}
+
+/* Removes VMA from SPT, destroying the pages created in it, which
+ * writes dirty file pages back. */
+void
+vma_unmap (struct supplemental_page_table *spt, struct vma *vma) {
+	if (VM_TYPE (vma->type) == VM_FILE)
+		file_writeback_area (vma, vma->start, vma->end);
+	while (!list_empty (&vma->pages)) {
+		struct list_elem *e = list_pop_front (&vma->pages);
+		spt_remove_page (spt, list_entry (e, struct page, vma_elem));
+	}
+	list_remove (&vma->elem);
+	file_close (vma->file);
+	free (vma);
+}
+
+/* Copies the areas of SRC into DST at fork, without their pages.
+ * Returns false on allocation failure. */
+bool
+vma_copy_all (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src) {
+	struct list_elem *e;
+
+	for (e = list_begin (&src->vmas); e != list_end (&src->vmas);
+			e = list_next (e)) {
+		struct vma *vma = list_entry (e, struct vma, elem);
+		struct vma *copy = vma_create (dst, vma->start,
+				vma->end - vma->start, vma->type, vma->writable, vma->file,
+				vma->offset, vma->read_bytes, vma->init);
+		if (copy == NULL)
+			return false;
+		copy->advice = vma->advice;
+	}
+	return true;
+}
+
+/* Frees every area of SPT.  The pages must have been destroyed
+ * already, since file pages write back through the area's file. */
+void
+vma_destroy_all (struct supplemental_page_table *spt) {
+	while (!list_empty (&spt->vmas)) {
+		struct vma *vma = list_entry (list_pop_front (&spt->vmas),
+				struct vma, elem);
+		file_close (vma->file);
+		free (vma);
+	}
+}
+
+static bool
+vma_less (const struct list_elem *a, const struct list_elem *b,
+		void *aux UNUSED) {
+	return list_entry (a, struct vma, elem)->start
+		< list_entry (b, struct vma, elem)->start;
+}
+
+/* Returns true if no area of SPT and no page outside an area lies
+ * in [START, END).  Stack pages are the only pages outside areas,
+ * and they stay within USER_STACK_MAX_SIZE of USER_STACK, so only
+ * that part of the range is looked up page by page. */
+static bool
+vma_range_is_free (struct supplemental_page_table *spt, void *start,
+		void *end) {
+	void *stack_low = (void *) (USER_STACK - USER_STACK_MAX_SIZE);
+	struct list_elem *e;
+	void *va;
+
+	for (e = list_begin (&spt->vmas); e != list_end (&spt->vmas);
+			e = list_next (e)) {
+		struct vma *vma = list_entry (e, struct vma, elem);
+		if (vma->start >= end)
+			break;
+		if (start < vma->end)
+			return false;
+	}
+
+	for (va = start > stack_low ? start : stack_low;
+			va < end && va < (void *) USER_STACK; va += PGSIZE)
+		if (spt_find_page (spt, va) != NULL)
+			return false;
+	return true;
+}
@@ -0,0 +1,335 @@
+/* zswap.c: Compressed in-memory swap pool.
+ *
+ * Anonymous pages are evicted here first.  Each page is
+ * compressed with a small LZ77 coder and kept in a pool of pages
+ * taken from the kernel pool at boot.  A page goes to the swap
+ * disk only if the pool is full or the page does not compress.
+ * Reading it back costs one decompression instead of eight
+ * sector reads.
+ *
+ * The pool is cut into ZSWAP_CHUNK-byte chunks.  A compressed
+ * page takes a run of chunks, found first-fit in a bitmap, and
+ * starts with a header.  The first chunk's index is the page's
+ * handle. */
+
+#include "vm/zswap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Allocation unit within the pool. */
+#define ZSWAP_CHUNK 64
+
+/* A page must compress to at most this many bytes, header
+ * included, to be kept. */
+#define ZSWAP_MAX_SIZE (PGSIZE * 3 / 4)
+
+/* Header at the start of a compressed page. */
+struct zswap_hdr {
+	uint16_t len;           /* Compressed bytes after the header. */
+	uint16_t chunk_cnt;     /* Chunks in the run. */
+	uint32_t refs;          /* Pages sharing it after fork. */
+};
+
+size_t zswap_pages = ZSWAP_DEFAULT_PAGES;
+
+static uint8_t *pool;                   /* zswap_pages pages. */
+static struct bitmap *chunk_map;        /* Chunks in use. */
+static struct lock zswap_lock;          /* Protects all of the above,
+                                           the buffers and counters. */
+
+/* Work areas for the compressor, used under zswap_lock. */
+#define HASH_BITS 12
+static uint16_t hash_table[1 << HASH_BITS];
+static uint8_t zbuf[ZSWAP_MAX_SIZE];
+
+/* Statistics. */
+static long long store_cnt;     /* Pages stored. */
+static long long reject_cnt;    /* Pages that did not compress. */
+static long long full_cnt;      /* Pages that found the pool full. */
+static long long hit_cnt;       /* Swap-ins served from the pool. */
+static long long miss_cnt;      /* Swap-ins read from the disk. */
+static long long in_bytes;      /* Bytes stored, before compression. */
+static long long out_bytes;     /* ...and after. */
+
+static size_t lz_compress (const uint8_t *src, uint8_t *dst, size_t max);
+static bool lz_decompress (const uint8_t *src, size_t len, uint8_t *dst);
+
+/* Sets up the pool, unless disabled with -zswap=0. */
+void
+zswap_init (void) {
+	lock_init (&zswap_lock);
+	if (zswap_pages == 0)
+		return;
+	pool = palloc_get_multiple (0, zswap_pages);
+	chunk_map = bitmap_create (zswap_pages * PGSIZE / ZSWAP_CHUNK);
+	if (pool == NULL || chunk_map == NULL) {
+		printf ("zswap: cannot allocate %zu pages, disabled\n", zswap_pages);
+		if (pool != NULL)
+			palloc_free_multiple (pool, zswap_pages);
+		pool = NULL;
+	}
+}
+
+static struct zswap_hdr *
+handle_to_hdr (size_t handle) {
+	return (struct zswap_hdr *) (pool + handle * ZSWAP_CHUNK);
+}
+
+/* Compresses the page at KVA into the pool, to be shared by REFS
+ * pages.  Returns true and sets *HANDLE on success, or false if
+ * the page should go to the swap disk instead. */
+bool
+zswap_store (const void *kva, unsigned refs, size_t *handle) {
+	struct zswap_hdr *hdr;
+	size_t len, chunk_cnt, chunk;
+
+	if (pool == NULL)
+		return false;
+
+	lock_acquire (&zswap_lock);
+	len = lz_compress (kva, zbuf, sizeof zbuf - sizeof *hdr);
+	if (len == 0) {
+		reject_cnt++;
+		lock_release (&zswap_lock);
+		return false;
+	}
+	chunk_cnt = (sizeof *hdr + len + ZSWAP_CHUNK - 1) / ZSWAP_CHUNK;
+	chunk = bitmap_scan_and_flip (chunk_map, 0, chunk_cnt, false);
+	if (chunk == BITMAP_ERROR) {
+		full_cnt++;
+		lock_release (&zswap_lock);
+		return false;
+	}
+
+	hdr = handle_to_hdr (chunk);
+	hdr->len = len;
+	hdr->chunk_cnt = chunk_cnt;
+	hdr->refs = refs;
+	memcpy (hdr + 1, zbuf, len);
+	store_cnt++;
+	in_bytes += PGSIZE;
+	out_bytes += chunk_cnt * ZSWAP_CHUNK;
+	lock_release (&zswap_lock);
+
+	*handle = chunk;
+	return true;
+}
+
+/* Decompresses the page stored as HANDLE into KVA. */
+void
+zswap_load (size_t handle, void *kva) {
+	struct zswap_hdr *hdr = handle_to_hdr (handle);
+	bool ok;
+
+	/* Stored pages do not move, and HANDLE is referenced by our
+	 * page, so only the counters need the lock. */
+	ok = lz_decompress ((uint8_t *) (hdr + 1), hdr->len, kva);
+	ASSERT (ok);
+
+	lock_acquire (&zswap_lock);
+	hit_cnt++;
+	lock_release (&zswap_lock);
+}
+
+/* Adds a page sharing HANDLE, at fork. */
+void
+zswap_ref (size_t handle) {
+	lock_acquire (&zswap_lock);
+	handle_to_hdr (handle)->refs++;
+	lock_release (&zswap_lock);
+}
+
+/* Drops one page's reference to HANDLE, freeing its chunks with
+ * the last one. */
+void
+zswap_unref (size_t handle) {
+	struct zswap_hdr *hdr = handle_to_hdr (handle);
+
+	lock_acquire (&zswap_lock);
+	ASSERT (hdr->refs > 0);
+	ASSERT (bitmap_all (chunk_map, handle, hdr->chunk_cnt));
+	if (--hdr->refs == 0)
+		bitmap_set_multiple (chunk_map, handle, hdr->chunk_cnt, false);
+	lock_release (&zswap_lock);
+}
+
+/* Counts a swap-in that had to read the swap disk. */
+void
+zswap_note_disk_load (void) {
+	lock_acquire (&zswap_lock);
+	miss_cnt++;
+	lock_release (&zswap_lock);
+}
+
+/* Prints the pool's statistics. */
+void
+zswap_print_stats (void) {
+	if (pool == NULL)
+		return;
+	printf ("Zswap: %lld stored, %lld incompressible, %lld pool full, "
+			"%lld hits, %lld misses\n",
+			store_cnt, reject_cnt, full_cnt, hit_cnt, miss_cnt);
+	printf ("Zswap: %zu of %zu chunks in use, compression ratio %lld%%\n",
+			bitmap_count (chunk_map, 0, bitmap_size (chunk_map), true),
+			bitmap_size (chunk_map),
+			out_bytes ? in_bytes * 100 / out_bytes : 0);
+}
+
+/* LZ77 coder.
+ *
+ * The output is a series of sequences.  Each one starts with a
+ * token byte: the high four bits are a literal count and the low
+ * four bits a match length minus LZ_MIN_MATCH.  Either field set
+ * to 15 continues in following bytes, each added on, until one
+ * below 255.  The literals come next, then the match as a
+ * two-byte little-endian distance back into the output.  The
+ * last sequence has literals only. */
+
+#define LZ_MIN_MATCH 4
+
+static uint32_t
+read32 (const uint8_t *p) {
+	uint32_t v;
+
+	memcpy (&v, p, sizeof v);
+	return v;
+}
+
+static size_t
+lz_hash (uint32_t v) {
+	return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/* Appends LEN in the extended length format to DST at *OP.
+ * Returns false if that would pass MAX. */
+static bool
+put_length (uint8_t *dst, size_t *op, size_t max, size_t len) {
+	for (; len >= 255; len -= 255) {
+		if (*op >= max)
+			return false;
+		dst[(*op)++] = 255;
+	}
+	if (*op >= max)
+		return false;
+	dst[(*op)++] = len;
+	return true;
+}
+
+/* Appends a sequence of the LIT_LEN literals at LIT and a match
+ * of MATCH_LEN bytes DIST back, or no match if MATCH_LEN is 0. */
+static bool
+put_sequence (uint8_t *dst, size_t *op, size_t max, const uint8_t *lit,
+		size_t lit_len, size_t dist, size_t match_len) {
+	size_t ml = match_len ? match_len - LZ_MIN_MATCH : 0;
+	uint8_t token = (lit_len < 15 ? lit_len : 15) << 4 | (ml < 15 ? ml : 15);
+
+	if (*op >= max)
+		return false;
+	dst[(*op)++] = token;
+	if (lit_len >= 15 && !put_length (dst, op, max, lit_len - 15))
+		return false;
+	if (*op + lit_len > max)
+		return false;
+	memcpy (dst + *op, lit, lit_len);
+	*op += lit_len;
+	if (match_len == 0)
+		return true;
+	if (*op + 2 > max)
+		return false;
+	dst[(*op)++] = dist & 0xff;
+	dst[(*op)++] = dist >> 8;
+	return ml < 15 || put_length (dst, op, max, ml - 15);
+}
+
+/* Compresses the page at SRC into DST.  Returns the compressed
+ * length, or 0 if it would exceed MAX bytes. */
+static size_t
+lz_compress (const uint8_t *src, uint8_t *dst, size_t max) {
+	size_t ip = 0, anchor = 0, op = 0;
+
+	memset (hash_table, 0, sizeof hash_table);
+	while (ip + LZ_MIN_MATCH <= PGSIZE) {
+		uint32_t v = read32 (src + ip);
+		size_t h = lz_hash (v);
+		size_t ref = hash_table[h];
+
+		/* Positions are stored plus one; 0 is empty. */
+		hash_table[h] = ip + 1;
+		if (ref != 0 && read32 (src + ref - 1) == v) {
+			size_t len = LZ_MIN_MATCH;
+
+			ref--;
+			while (ip + len < PGSIZE && src[ref + len] == src[ip + len])
+				len++;
+			if (!put_sequence (dst, &op, max, src + anchor, ip - anchor,
+						ip - ref, len))
+				return 0;
+			ip += len;
+			anchor = ip;
+		} else
+			ip++;
+	}
+	if (!put_sequence (dst, &op, max, src + anchor, PGSIZE - anchor, 0, 0))
+		return 0;
+	return op;
+}
+
+/* Reads an extended length from SRC at *IP, of LEN bytes, into
+ * *VALUE.  Returns false on truncated input. */
+static bool
+get_length (const uint8_t *src, size_t *ip, size_t len, size_t *value) {
+	uint8_t b;
+
+	do {
+		if (*ip >= len)
+			return false;
+		b = src[(*ip)++];
+		*value += b;
+	} while (b == 255);
+	return true;
+}
+
+/* Decompresses LEN bytes at SRC into the page at DST.  Returns
+ * false if the input is malformed. */
+static bool
+lz_decompress (const uint8_t *src, size_t len, uint8_t *dst) {
+	size_t ip = 0, op = 0;
+
+	while (ip < len) {
+		uint8_t token = src[ip++];
+		size_t lit_len = token >> 4;
+		size_t match_len = token & 15;
+		size_t dist;
+
+		if (lit_len == 15 && !get_length (src, &ip, len, &lit_len))
+			return false;
+		if (ip + lit_len > len || op + lit_len > PGSIZE)
+			return false;
+		memcpy (dst + op, src + ip, lit_len);
+		ip += lit_len;
+		op += lit_len;
+		if (ip == len)
+			break;
+
+		if (ip + 2 > len)
+			return false;
+		dist = src[ip] | src[ip + 1] << 8;
+		ip += 2;
+		if (match_len == 15 && !get_length (src, &ip, len, &match_len))
+			return false;
+		match_len += LZ_MIN_MATCH;
+		if (dist == 0 || dist > op || op + match_len > PGSIZE)
+			return false;
+
+		/* Byte by byte: the match may overlap its own output. */
+		for (; match_len > 0; match_len--, op++)
+			dst[op] = dst[op - dist];
+	}
+	return op == PGSIZE;
+}